@@ -0,0 +1,132 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+// Release mode, where assertDbg becomes an assumption.
+#define ERRANTIBUS_NODEBUG
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <array>
+#include <cstddef>
+#include <numeric>
+
+/*
+ * Each pair compiles the same loop with and without an assumption. The
+ * functions get sections of their own, like in codeSize.cpp, so that the
+ * code bytes show what the assumption changes. This file is built with -O3,
+ * like a CMake release build, as -O2 vectorizes only the simplest loops.
+ */
+extern "C" const char __start_errantibus_bench_assumed_samples[];
+extern "C" const char __stop_errantibus_bench_assumed_samples[];
+extern "C" const char __start_errantibus_bench_plain_samples[];
+extern "C" const char __stop_errantibus_bench_plain_samples[];
+extern "C" const char __start_errantibus_bench_assumed_blocks[];
+extern "C" const char __stop_errantibus_bench_assumed_blocks[];
+extern "C" const char __start_errantibus_bench_plain_blocks[];
+extern "C" const char __stop_errantibus_bench_plain_blocks[];
+
+namespace {
+
+constexpr std::size_t capacity = 4096;
+
+#define SECTION_BYTES(name)                                                    \
+  static_cast<std::size_t>(__stop_errantibus_bench_##name -                    \
+                           __start_errantibus_bench_##name)
+
+/// A buffer of fixed capacity, of which the first `count` values are used.
+struct Samples {
+  std::array<int, capacity> values;
+  std::size_t count;
+};
+
+/// With the assumption, `at` cannot throw, so its check goes away and the
+/// loop is vectorized.
+[[gnu::noipa, gnu::section("errantibus_bench_assumed_samples")]] auto
+sumSamplesAssumed(const Samples &samples) -> int {
+  assertDbgLe(samples.count, capacity, "more samples than capacity");
+  int sum = 0;
+  for (std::size_t i = 0; i < samples.count; ++i) {
+    sum += samples.values.at(i);
+  }
+  return sum;
+}
+
+[[gnu::noipa, gnu::section("errantibus_bench_plain_samples")]] auto
+sumSamples(const Samples &samples) -> int {
+  int sum = 0;
+  for (std::size_t i = 0; i < samples.count; ++i) {
+    sum += samples.values.at(i);
+  }
+  return sum;
+}
+
+/// With the assumption, the vectorized loop needs no scalar remainder.
+[[gnu::noipa, gnu::section("errantibus_bench_assumed_blocks")]] auto
+sumBlocksAssumed(const int *values, std::size_t n) -> int {
+  assertDbg(n % 16 == 0, "not a whole number of blocks");
+  int sum = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    sum += values[i];
+  }
+  return sum;
+}
+
+[[gnu::noipa, gnu::section("errantibus_bench_plain_blocks")]] auto
+sumBlocks(const int *values, std::size_t n) -> int {
+  int sum = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    sum += values[i];
+  }
+  return sum;
+}
+
+auto fullSamples() -> Samples {
+  auto samples = Samples();
+  std::iota(samples.values.begin(), samples.values.end(), 0);
+  samples.count = capacity;
+  return samples;
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(sumSamplesAssumption) {
+  auto samples = fullSamples();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(sumSamplesAssumed(samples));
+  }
+  state.bytesProcessed = state.iterations * capacity * sizeof(int);
+  state.codeBytes = SECTION_BYTES(assumed_samples);
+}
+
+ERRANTIBUS_BENCHMARK(sumSamplesChecked) {
+  auto samples = fullSamples();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(sumSamples(samples));
+  }
+  state.bytesProcessed = state.iterations * capacity * sizeof(int);
+  state.codeBytes = SECTION_BYTES(plain_samples);
+}
+
+ERRANTIBUS_BENCHMARK(sumBlocksAssumption) {
+  auto samples = fullSamples();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(
+        sumBlocksAssumed(samples.values.data(), samples.count));
+  }
+  state.bytesProcessed = state.iterations * capacity * sizeof(int);
+  state.codeBytes = SECTION_BYTES(assumed_blocks);
+}
+
+ERRANTIBUS_BENCHMARK(sumBlocksPlain) {
+  auto samples = fullSamples();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(
+        sumBlocks(samples.values.data(), samples.count));
+  }
+  state.bytesProcessed = state.iterations * capacity * sizeof(int);
+  state.codeBytes = SECTION_BYTES(plain_blocks);
+}
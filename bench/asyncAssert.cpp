@@ -0,0 +1,66 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+/*
+ * A caller that does some work on a shared, immutable state and asserts an
+ * invariant of it that takes about as long to verify. The difference to
+ * the baseline is what the assertion costs the caller: all of the
+ * verification inline, and only handing over the snapshot on the pool.
+ */
+
+namespace {
+
+constexpr std::size_t stateSize = std::size_t{1} << 16;
+
+auto makeState() -> std::shared_ptr<const std::vector<int>> {
+  auto state = std::vector<int>(stateSize);
+  std::iota(state.begin(), state.end(), 0);
+  return std::make_shared<const std::vector<int>>(std::move(state));
+}
+
+auto isSorted(const std::shared_ptr<const std::vector<int>> &state) -> bool {
+  return std::ranges::is_sorted(*state);
+}
+
+[[gnu::noinline]] auto work(const std::vector<int> &state) -> long {
+  return std::accumulate(state.begin(), state.end(), 0L);
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(asyncAssertBaseline) {
+  auto shared = makeState();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(work(*shared));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(asyncAssertInline) {
+  auto shared = makeState();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(work(*shared));
+    assertAsync(shared, isSorted, "state is sorted", i);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(asyncAssertOffloaded) {
+  auto shared = makeState();
+  errantibus::enableAsyncAssertions({.threads = 2, .queueCapacity = 64});
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(work(*shared));
+    assertAsync(shared, isSorted, "state is sorted", i);
+  }
+  errantibus::disableAsyncAssertions();
+}
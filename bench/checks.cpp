@@ -0,0 +1,52 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+ERRANTIBUS_BENCHMARK(checkPassing) {
+  std::size_t limit = state.iterations;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    checkAlwaysLt(i, limit, "in bounds", i);
+  }
+}
+
+/// A check that fails every time, past its full reports: the cost of a
+/// failure that is only counted and passed to the handler.
+ERRANTIBUS_BENCHMARK(checkFailingCounted) {
+  errantibus::setCheckOptions(
+      {.handler = errantibus::countCheckFailure, .fullReports = 0});
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    checkAlwaysLt(i, std::size_t{0}, "never holds", i);
+  }
+  errantibus::setCheckOptions({});
+}
+
+/// A check that fails every time with a full report, written to memory: the
+/// end-to-end latency of a failure report, from capturing the stack through
+/// symbolizing it and loading its sources to encoding the text. The parts
+/// are measured on their own by captureStack, symbolizeTrace* and
+/// sourceContextReport*.
+ERRANTIBUS_BENCHMARK(checkFailingReported) {
+  auto memory = errantibus::MemorySink();
+  errantibus::setOutput(
+      {.sink = memory.sink(), .colors = errantibus::ColorMode::never});
+  errantibus::setCheckOptions(
+      {.fullReports = std::numeric_limits<std::uint32_t>::max()});
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    checkAlwaysLt(i, std::size_t{0}, "never holds", i);
+    memory.clear();
+  }
+  errantibus::setCheckOptions({});
+  errantibus::setOutput({});
+}
@@ -0,0 +1,154 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+
+// Each function under test gets a section of its own, whose size the
+// linker provides through __start_ and __stop_ symbols. Cold code that is
+// outlined from the functions is placed elsewhere and not counted.
+#define CODE_SECTION(name)                                                     \
+  extern "C" const char __start_errantibus_bench_##name[];                     \
+  extern "C" const char __stop_errantibus_bench_##name[]
+
+#define CODE_BYTES(name)                                                       \
+  static_cast<std::size_t>(__stop_errantibus_bench_##name -                    \
+                           __start_errantibus_bench_##name)
+
+CODE_SECTION(checked);
+CODE_SECTION(unchecked);
+CODE_SECTION(siteRawIf);
+CODE_SECTION(siteAssertAlways);
+CODE_SECTION(siteAssertAlwaysLt);
+CODE_SECTION(siteCheckAlways);
+
+namespace {
+
+constexpr std::size_t steps = 20;
+
+#define CHECKED_STEP(i)                                                        \
+  if constexpr ((i) % 2 == 0) {                                                \
+    assertAlways(values[i] >= 0, "negative value", i, values[i]);              \
+  } else {                                                                     \
+    assertAlwaysNeq(values[i], -1, "sentinel in input", i, values);            \
+  }                                                                            \
+  sum += values[i]
+
+#define UNCHECKED_STEP(i) sum += values[i]
+
+#define TWENTY_STEPS(step)                                                     \
+  step(0);                                                                     \
+  step(1);                                                                     \
+  step(2);                                                                     \
+  step(3);                                                                     \
+  step(4);                                                                     \
+  step(5);                                                                     \
+  step(6);                                                                     \
+  step(7);                                                                     \
+  step(8);                                                                     \
+  step(9);                                                                     \
+  step(10);                                                                    \
+  step(11);                                                                    \
+  step(12);                                                                    \
+  step(13);                                                                    \
+  step(14);                                                                    \
+  step(15);                                                                    \
+  step(16);                                                                    \
+  step(17);                                                                    \
+  step(18);                                                                    \
+  step(19)
+
+using Values = std::array<int, steps>;
+
+[[gnu::noinline, gnu::section("errantibus_bench_checked")]] auto
+checkedSum(const Values &values) -> int {
+  int sum = 0;
+  TWENTY_STEPS(CHECKED_STEP);
+  return sum;
+}
+
+[[gnu::noinline, gnu::section("errantibus_bench_unchecked")]] auto
+uncheckedSum(const Values &values) -> int {
+  int sum = 0;
+  TWENTY_STEPS(UNCHECKED_STEP);
+  return sum;
+}
+
+// A single site of each kind, next to the `if` it replaces, so that the
+// bytes one assertion adds to its caller can be read off directly.
+
+[[gnu::noinline, gnu::section("errantibus_bench_siteRawIf")]] auto
+rawIfSite(const Values &values) -> int {
+  if (!(values[0] < values[1])) [[unlikely]] {
+    std::abort();
+  }
+  return values[0] + 1;
+}
+
+[[gnu::noinline, gnu::section("errantibus_bench_siteAssertAlways")]] auto
+assertAlwaysSite(const Values &values) -> int {
+  assertAlways(values[0] < values[1], "in bounds", values);
+  return values[0] + 1;
+}
+
+[[gnu::noinline, gnu::section("errantibus_bench_siteAssertAlwaysLt")]] auto
+assertAlwaysLtSite(const Values &values) -> int {
+  assertAlwaysLt(values[0], values[1], "in bounds", values);
+  return values[0] + 1;
+}
+
+[[gnu::noinline, gnu::section("errantibus_bench_siteCheckAlways")]] auto
+checkAlwaysSite(const Values &values) -> int {
+  checkAlways(values[0] < values[1], "in bounds", values);
+  return values[0] + 1;
+}
+
+auto inputValues() -> Values {
+  auto values = Values();
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int>(i);
+  }
+  return values;
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(sumTwentyAssertions) {
+  auto values = inputValues();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values);
+    errantibus::bench::doNotOptimize(checkedSum(values));
+  }
+  state.codeBytes = CODE_BYTES(checked);
+}
+
+ERRANTIBUS_BENCHMARK(sumNoAssertions) {
+  auto values = inputValues();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values);
+    errantibus::bench::doNotOptimize(uncheckedSum(values));
+  }
+  state.codeBytes = CODE_BYTES(unchecked);
+}
+
+#define SITE_BENCHMARK(name, site)                                             \
+  ERRANTIBUS_BENCHMARK(name) {                                                 \
+    auto values = inputValues();                                               \
+    for (std::size_t i = 0; i < state.iterations; ++i) {                       \
+      errantibus::bench::doNotOptimize(values);                                \
+      errantibus::bench::doNotOptimize(site(values));                          \
+    }                                                                          \
+    state.codeBytes = CODE_BYTES(name);                                        \
+  }
+
+SITE_BENCHMARK(siteRawIf, rawIfSite)
+SITE_BENCHMARK(siteAssertAlways, assertAlwaysSite)
+SITE_BENCHMARK(siteAssertAlwaysLt, assertAlwaysLtSite)
+SITE_BENCHMARK(siteCheckAlways, checkAlwaysSite)
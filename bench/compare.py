@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+#
+# Errantibus, by Jakob Teuber
+# See <https://github.com/jakobteuber/errantibus>
+#
+"""Compare two result files of `errantibus_bench --json=...`.
+
+Prints every benchmark whose results changed and exits with 1 if one of
+them regressed: time or instructions per operation grew by more than the
+threshold, or allocations per operation or code bytes grew at all. Only
+the Python standard library is used.
+"""
+
+import argparse
+import json
+import sys
+
+# Metric, unit, and for deterministic metrics the absolute change that is
+# tolerated, instead of the relative threshold. Allocation counts are
+# averages over many iterations, so warm-up effects show as fractions.
+METRICS = [
+    ("nsPerOp", "ns/op", None),
+    ("instructionsPerOp", "instr/op", None),
+    ("allocsPerOp", "allocs/op", 0.01),
+    ("codeBytes", "code bytes", 0),
+]
+
+
+def load(path):
+    with open(path, encoding="utf-8") as file:
+        results = json.load(file)
+    benchmarks = {entry["name"]: entry for entry in results["benchmarks"]}
+    return results.get("context", {}), benchmarks
+
+
+def change(old, new):
+    if old == 0:
+        return float("inf") if new > 0 else 0.0
+    return (new - old) / old
+
+
+def compare(old, new, threshold, metrics):
+    """Yield (name, unit, old, new, regressed) for each changed metric."""
+    for name in sorted(old.keys() & new.keys()):
+        for metric, unit, tolerance in METRICS:
+            if metric not in metrics:
+                continue
+            before = old[name].get(metric)
+            after = new[name].get(metric)
+            if before is None or after is None or before == after:
+                continue
+            if tolerance is None:
+                delta, limit = change(before, after), threshold
+            else:
+                delta, limit = after - before, tolerance
+            if abs(delta) > limit:
+                yield name, unit, before, after, delta > 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline", help="results of the old commit")
+    parser.add_argument("current", help="results of the new commit")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.10,
+        help="relative growth of time and instructions that counts as a "
+        "regression (default: 0.10)",
+    )
+    parser.add_argument(
+        "--metrics",
+        default=",".join(metric for metric, _, _ in METRICS),
+        help="comma-separated metrics to compare (default: all of %(default)s)",
+    )
+    args = parser.parse_args()
+
+    old_context, old = load(args.baseline)
+    new_context, new = load(args.current)
+    if old_context != new_context:
+        print(f"warning: results come from different builds:\n"
+              f"  {args.baseline}: {old_context}\n"
+              f"  {args.current}: {new_context}", file=sys.stderr)
+
+    metrics = set(args.metrics.split(","))
+    regressions = 0
+    for name, unit, before, after, regressed in compare(
+            old, new, args.threshold, metrics):
+        regressions += regressed
+        relative = change(before, after)
+        print(f"{'REGRESSED' if regressed else 'improved':9} {name:48} "
+              f"{before:14.1f} -> {after:14.1f} {unit:10} ({relative:+.1%})")
+    for name in sorted(old.keys() - new.keys()):
+        print(f"{'missing':9} {name}")
+    for name in sorted(new.keys() - old.keys()):
+        print(f"{'new':9} {name}")
+
+    if regressions != 0:
+        print(f"{regressions} regression(s) beyond a threshold of "
+              f"{args.threshold:.0%}", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
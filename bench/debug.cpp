@@ -0,0 +1,147 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Sends stderr to /dev/null while a benchmark prints its messages.
+class SilenceStderr {
+public:
+  SilenceStderr() : saved(dup(STDERR_FILENO)) {
+    int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    dup2(null, STDERR_FILENO);
+    close(null);
+  }
+  SilenceStderr(const SilenceStderr &) = delete;
+  SilenceStderr(SilenceStderr &&) = delete;
+  auto operator=(const SilenceStderr &) -> SilenceStderr & = delete;
+  auto operator=(SilenceStderr &&) -> SilenceStderr & = delete;
+  ~SilenceStderr() {
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+  }
+
+private:
+  int saved;
+};
+
+void debugInts(std::size_t iterations) {
+  for (std::size_t i = 0; i < iterations; ++i) {
+    int request = static_cast<int>(i);
+    int shard = request % 16;
+    debug(request, shard);
+  }
+}
+
+void debugStrings(std::size_t iterations) {
+  auto user = std::string("jakob.teuber@example.org");
+  const char *state = "connected";
+  for (std::size_t i = 0; i < iterations; ++i) {
+    debug(user, state);
+  }
+}
+
+void debugNestedVectors(std::size_t iterations) {
+  auto matrix = std::vector<std::vector<int>>{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+  for (std::size_t i = 0; i < iterations; ++i) {
+    debug(matrix);
+  }
+}
+
+auto millionInts() -> const std::vector<int> & {
+  static const auto values = [] {
+    auto result = std::vector<int>(1'000'000);
+    std::iota(result.begin(), result.end(), 0);
+    return result;
+  }();
+  return values;
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(formatInts) {
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    int request = static_cast<int>(i);
+    double load = 0.75;
+    auto report = errantibus::internal::generateReport(request, load, i);
+    errantibus::bench::doNotOptimize(report);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(formatStrings) {
+  auto user = std::string("jakob.teuber@example.org");
+  const char *status = "connected";
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto report = errantibus::internal::generateReport(user, status);
+    errantibus::bench::doNotOptimize(report);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(formatNestedVectors) {
+  auto matrix = std::vector<std::vector<int>>{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto report = errantibus::internal::generateReport(matrix);
+    errantibus::bench::doNotOptimize(report);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(formatMillionInts) {
+  const auto &values = millionInts();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto report = errantibus::internal::generateReport(values);
+    errantibus::bench::doNotOptimize(report);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(formatMillionIntsUnbounded) {
+  const auto &values = millionInts();
+  constexpr auto unlimited = std::numeric_limits<std::size_t>::max();
+  errantibus::setFormatLimits({unlimited, unlimited, unlimited});
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto report = errantibus::internal::generateReport(values);
+    errantibus::bench::doNotOptimize(report);
+  }
+  errantibus::setFormatLimits({});
+}
+
+ERRANTIBUS_BENCHMARK(debugSyncInts) {
+  auto silence = SilenceStderr();
+  debugInts(state.iterations);
+}
+
+ERRANTIBUS_BENCHMARK(debugSyncStrings) {
+  auto silence = SilenceStderr();
+  debugStrings(state.iterations);
+}
+
+ERRANTIBUS_BENCHMARK(debugSyncNestedVectors) {
+  auto silence = SilenceStderr();
+  debugNestedVectors(state.iterations);
+}
+
+ERRANTIBUS_BENCHMARK(debugAsyncIntsSustained) {
+  auto silence = SilenceStderr();
+  errantibus::enableAsyncDebug({.overflow = errantibus::OverflowPolicy::block});
+  debugInts(state.iterations);
+  errantibus::disableAsyncDebug();
+}
+
+ERRANTIBUS_BENCHMARK(debugAsyncIntsCallerDrop) {
+  auto silence = SilenceStderr();
+  errantibus::enableAsyncDebug({.overflow = errantibus::OverflowPolicy::drop});
+  debugInts(state.iterations);
+  errantibus::disableAsyncDebug();
+}
@@ -0,0 +1,25 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <string>
+
+ERRANTIBUS_BENCHMARK(recordInts) {
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto a = static_cast<int>(i);
+    auto b = a * 3;
+    errantibusRecord(a, b);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(recordStrings) {
+  auto name = std::string("breadcrumb");
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibusRecord(i, name);
+  }
+}
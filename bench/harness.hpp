@@ -0,0 +1,53 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_BENCH_HARNESS_HPP
+#define ERRANTIBUS_BENCH_HARNESS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace errantibus::bench {
+
+/**
+ * @brief Passed to every benchmark. The benchmark runs its operation
+ * `iterations` times and may report how many bytes it processed, and how
+ * large the code under test is.
+ */
+struct State {
+  std::size_t iterations = 1;
+  std::size_t bytesProcessed = 0;
+  std::size_t codeBytes = 0;
+};
+
+using Benchmark = void (*)(State &);
+
+auto registerBenchmark(std::string_view name, Benchmark benchmark) -> bool;
+
+/**
+ * @brief Number of heap allocations made by the current process so far.
+ */
+auto allocationCount() -> std::uint64_t;
+
+/**
+ * @brief Keeps the compiler from optimizing away `value`.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void clobberMemory() { asm volatile("" : : : "memory"); }
+
+} // namespace errantibus::bench
+
+#define ERRANTIBUS_BENCHMARK(name)                                             \
+  static void name(errantibus::bench::State &state);                           \
+  [[maybe_unused]] static const bool name##Registered =                        \
+      errantibus::bench::registerBenchmark(#name, name);                       \
+  static void name(errantibus::bench::State &state)
+
+#endif // !ERRANTIBUS_BENCH_HARNESS_HPP
@@ -0,0 +1,284 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::atomic<std::uint64_t> allocations = 0;
+
+#ifndef ERRANTIBUS_BENCH_BUILD_TYPE
+#define ERRANTIBUS_BENCH_BUILD_TYPE ""
+#endif
+
+using Registry =
+    std::vector<std::pair<std::string_view, errantibus::bench::Benchmark>>;
+
+auto registry() -> Registry & {
+  static auto benchmarks = Registry();
+  return benchmarks;
+}
+
+/**
+ * @brief Counts the instructions the process retires in user space, where
+ * the kernel and the hardware allow it.
+ */
+class InstructionCounter {
+public:
+  InstructionCounter() {
+    auto attributes = perf_event_attr();
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    fd = static_cast<int>(
+        ::syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+  }
+  InstructionCounter(const InstructionCounter &) = delete;
+  InstructionCounter(InstructionCounter &&) = delete;
+  auto operator=(const InstructionCounter &) -> InstructionCounter & = delete;
+  auto operator=(InstructionCounter &&) -> InstructionCounter & = delete;
+  ~InstructionCounter() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  void start() {
+    if (fd >= 0) {
+      ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  auto stop() -> std::optional<std::uint64_t> {
+    if (fd < 0) {
+      return std::nullopt;
+    }
+    ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    std::uint64_t count = 0;
+    if (::read(fd, &count, sizeof(count)) != sizeof(count)) {
+      return std::nullopt;
+    }
+    return count;
+  }
+
+private:
+  int fd = -1;
+};
+
+struct Options {
+  std::string_view filter;
+  double minTime = 0.2;
+  /// Where to write the results as JSON, if anywhere.
+  std::string_view json = {};
+};
+
+auto parseOptions(int argc, char **argv) -> Options {
+  auto options = Options();
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string_view(argv[i]);
+    if (arg.starts_with("--filter=")) {
+      options.filter = arg.substr(9);
+    } else if (arg.starts_with("--min-time=")) {
+      options.minTime = std::strtod(argv[i] + 11, nullptr);
+    } else if (arg.starts_with("--json=")) {
+      options.json = arg.substr(7);
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--filter=substring] [--min-time=seconds] "
+                   "[--json=file]\n",
+                   argv[0]);
+      std::exit(2);
+    }
+  }
+  return options;
+}
+
+struct Result {
+  std::string_view name;
+  std::size_t iterations = 0;
+  double nsPerOp = 0;
+  double allocsPerOp = 0;
+  /// Zero if the benchmark does not report the bytes it processed.
+  double bytesPerSecond = 0;
+  std::optional<double> instructionsPerOp = std::nullopt;
+  std::size_t codeBytes = 0;
+};
+
+auto run(std::string_view name, errantibus::bench::Benchmark benchmark,
+         const Options &options) -> Result {
+  using Clock = std::chrono::steady_clock;
+  auto state = errantibus::bench::State();
+  benchmark(state); // warm up caches, helpers and lazy initialization
+
+  std::size_t iterations = 1;
+  double seconds = 0;
+  std::uint64_t allocated = 0;
+  auto counter = InstructionCounter();
+  auto instructions = std::optional<std::uint64_t>();
+  while (true) {
+    state = errantibus::bench::State{iterations, 0, 0};
+    auto before = allocations.load(std::memory_order_relaxed);
+    counter.start();
+    auto start = Clock::now();
+    benchmark(state);
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    instructions = counter.stop();
+    allocated = allocations.load(std::memory_order_relaxed) - before;
+    if (seconds >= options.minTime || iterations >= (std::size_t{1} << 32)) {
+      break;
+    }
+    auto scale = seconds > 0 ? 1.4 * options.minTime / seconds : 100.0;
+    iterations = static_cast<std::size_t>(static_cast<double>(iterations) *
+                                          std::clamp(scale, 2.0, 100.0));
+  }
+
+  auto n = static_cast<double>(iterations);
+  auto result = Result{.name = name,
+                       .iterations = iterations,
+                       .nsPerOp = seconds * 1e9 / n,
+                       .allocsPerOp = static_cast<double>(allocated) / n,
+                       .codeBytes = state.codeBytes};
+  if (state.bytesProcessed != 0) {
+    result.bytesPerSecond = static_cast<double>(state.bytesProcessed) / seconds;
+  }
+  if (instructions) {
+    result.instructionsPerOp = static_cast<double>(*instructions) / n;
+  }
+  return result;
+}
+
+void print(const Result &result) {
+  std::printf("%-48.*s %12zu iter %14.1f ns/op %10.2f allocs/op",
+              static_cast<int>(result.name.size()), result.name.data(),
+              result.iterations, result.nsPerOp, result.allocsPerOp);
+  if (result.bytesPerSecond != 0) {
+    std::printf(" %8.2f GB/s", result.bytesPerSecond / 1e9);
+  }
+  if (result.instructionsPerOp) {
+    std::printf(" %10.1f instr/op", *result.instructionsPerOp);
+  }
+  if (result.codeBytes != 0) {
+    std::printf(" %8zu code bytes", result.codeBytes);
+  }
+  std::printf("\n");
+  std::fflush(stdout);
+}
+
+/**
+ * @brief Write the results as one JSON object, for bench/compare.py. Names
+ * of benchmarks are identifiers, so nothing needs escaping.
+ */
+auto writeJson(const std::string &path, const std::vector<Result> &results)
+    -> bool {
+  auto *out = std::fopen(path.c_str(), "w");
+  if (out == nullptr) {
+    return false;
+  }
+  std::fprintf(out,
+               "{\n  \"context\": {\"compiler\": \"%s\", "
+               "\"buildType\": \"%s\"},\n  \"benchmarks\": [",
+               __VERSION__, ERRANTIBUS_BENCH_BUILD_TYPE);
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const auto &result = results[i];
+    std::fprintf(out,
+                 "%s\n    {\"name\": \"%.*s\", \"iterations\": %zu, "
+                 "\"nsPerOp\": %.3f, \"allocsPerOp\": %.3f, "
+                 "\"bytesPerSecond\": %.0f, ",
+                 i == 0 ? "" : ",", static_cast<int>(result.name.size()),
+                 result.name.data(), result.iterations, result.nsPerOp,
+                 result.allocsPerOp, result.bytesPerSecond);
+    if (result.instructionsPerOp) {
+      std::fprintf(out, "\"instructionsPerOp\": %.1f, ",
+                   *result.instructionsPerOp);
+    } else {
+      std::fprintf(out, "\"instructionsPerOp\": null, ");
+    }
+    std::fprintf(out, "\"codeBytes\": %zu}", result.codeBytes);
+  }
+  std::fprintf(out, "\n  ]\n}\n");
+  return std::fclose(out) == 0;
+}
+
+} // namespace
+
+namespace errantibus::bench {
+
+auto registerBenchmark(std::string_view name, Benchmark benchmark) -> bool {
+  registry().emplace_back(name, benchmark);
+  return true;
+}
+
+auto allocationCount() -> std::uint64_t {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+} // namespace errantibus::bench
+
+auto operator new(std::size_t size) -> void * {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+auto operator new(std::size_t size, std::align_val_t align) -> void * {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  auto alignment = static_cast<std::size_t>(align);
+  auto rounded = (std::max(size, std::size_t{1}) + alignment - 1) / alignment
+               * alignment;
+  if (void *p = std::aligned_alloc(alignment, rounded)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+auto main(int argc, char **argv) -> int {
+  auto options = parseOptions(argc, argv);
+  auto &benchmarks = registry();
+  std::sort(benchmarks.begin(), benchmarks.end());
+  auto results = std::vector<Result>();
+  for (auto [name, benchmark] : benchmarks) {
+    if (name.find(options.filter) != std::string_view::npos) {
+      results.push_back(run(name, benchmark, options));
+      print(results.back());
+    }
+  }
+  if (!options.json.empty() &&
+      !writeJson(std::string(options.json), results)) {
+    std::fprintf(stderr, "%.*s: cannot be written\n",
+                 static_cast<int>(options.json.size()), options.json.data());
+    return 1;
+  }
+  return 0;
+}
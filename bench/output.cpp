@@ -0,0 +1,65 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus/output.hpp>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr std::array<std::string_view, 2> expressions = {"index", "name"};
+constexpr std::array<std::string_view, 2> values = {"`42`", "`\"parser\"`"};
+constexpr std::array operands = {
+    errantibus::Operand{errantibus::OperandRole::left, "count", "`17`"},
+    errantibus::Operand{errantibus::OperandRole::right, "limit", "`16`"}};
+const std::array frames = {
+    errantibus::Frame{reinterpret_cast<const void *>(0x401a2c),
+                      "parse(std::span<char const>)", "parser.cpp", 120},
+    errantibus::Frame{reinterpret_cast<const void *>(0x4011f0), "main",
+                      "main.cpp", 12}};
+
+/// A typical failed comparison, with frames that have no source to show.
+const auto entry = errantibus::Entry{
+    .kind = errantibus::EntryKind::check,
+    .file = "src/parser.cpp",
+    .line = 120,
+    .message = "too many tokens",
+    .thread = 4242,
+    .expectation = "Should be less than or equal, but was greater:",
+    .operands = operands,
+    .expressions = expressions,
+    .values = values,
+    .frames = frames,
+    .failures = 1};
+
+void encodeEntries(errantibus::bench::State &state,
+                   errantibus::Encoder encoder) {
+  auto out = std::string();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    out.clear();
+    encoder(out, std::span(&entry, 1), false);
+    errantibus::bench::doNotOptimize(out.data());
+    state.bytesProcessed += out.size();
+  }
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(encodeText) {
+  encodeEntries(state, errantibus::encodeText);
+}
+
+ERRANTIBUS_BENCHMARK(encodeJsonLines) {
+  encodeEntries(state, errantibus::encodeJsonLines);
+}
+
+ERRANTIBUS_BENCHMARK(encodeBinary) {
+  encodeEntries(state, errantibus::encodeBinary);
+}
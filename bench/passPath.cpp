@@ -0,0 +1,74 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+
+// The same bounds check on the passing path, written as a plain `if` and
+// with each kind of macro, so that their overhead over it can be compared.
+
+ERRANTIBUS_BENCHMARK(passRawIf) {
+  std::size_t limit = state.iterations;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    if (!(i < limit)) [[unlikely]] {
+      std::abort();
+    }
+  }
+}
+
+ERRANTIBUS_BENCHMARK(passAssertAlways) {
+  std::size_t limit = state.iterations;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    assertAlways(i < limit, "in bounds", i);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(passAssertDbg) {
+  std::size_t limit = state.iterations;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    assertDbg(i < limit, "in bounds", i);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(passAssertAlwaysLt) {
+  std::size_t limit = state.iterations;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    assertAlwaysLt(i, limit, "in bounds", i);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(passAssertAlwaysNeq) {
+  std::size_t sentinel = std::numeric_limits<std::size_t>::max();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    assertAlwaysNeq(i, sentinel, "not the sentinel", i);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(passAssertAlwaysNear) {
+  double limit = static_cast<double>(state.iterations);
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    auto x = static_cast<double>(i);
+    assertAlwaysNear(x, x + 0.5, limit, "close enough", i);
+  }
+}
+
+ERRANTIBUS_BENCHMARK(passCheckAlways) {
+  std::size_t limit = state.iterations;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(i);
+    checkAlways(i < limit, "in bounds", i);
+  }
+}
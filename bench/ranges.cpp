@@ -0,0 +1,115 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <numeric>
+#include <vector>
+
+/*
+ * Each pair checks the same 64 KiB array, which stays in the cache, once
+ * with a range assertion and once with assertAlways in a loop.
+ */
+
+namespace {
+
+constexpr std::size_t elements = 16 * 1024;
+
+auto ascending() -> std::vector<int> {
+  auto values = std::vector<int>(elements);
+  std::iota(values.begin(), values.end(), 0);
+  return values;
+}
+
+auto halves() -> std::vector<float> {
+  return std::vector<float>(elements, 0.5F);
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(allInRangeInts) {
+  auto values = ascending();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    assertAlwaysAllInRange(values, 0, elements, "index out of bounds");
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(int);
+}
+
+ERRANTIBUS_BENCHMARK(allInRangeIntsLoop) {
+  auto values = ascending();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    for (auto value : values) {
+      assertAlways(value >= 0 && value <= int{elements},
+                   "index out of bounds");
+    }
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(int);
+}
+
+ERRANTIBUS_BENCHMARK(sortedInts) {
+  auto values = ascending();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    assertAlwaysSorted(values, "must be sorted");
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(int);
+}
+
+ERRANTIBUS_BENCHMARK(sortedIntsLoop) {
+  auto values = ascending();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    for (std::size_t j = 1; j < values.size(); ++j) {
+      assertAlways(values[j - 1] <= values[j], "must be sorted");
+    }
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(int);
+}
+
+ERRANTIBUS_BENCHMARK(noNaNFloats) {
+  auto values = halves();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    assertAlwaysNoNaN(values, "must not be NaN");
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(float);
+}
+
+ERRANTIBUS_BENCHMARK(noNaNFloatsLoop) {
+  auto values = halves();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    for (auto value : values) {
+      assertAlways(value == value, "must not be NaN");
+    }
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(float);
+}
+
+ERRANTIBUS_BENCHMARK(allPredicate) {
+  auto values = ascending();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    assertAlwaysAll(
+        values, [](int value) { return value % 2 == 0 || value > 0; },
+        "odd values must be positive");
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(int);
+}
+
+ERRANTIBUS_BENCHMARK(allPredicateLoop) {
+  auto values = ascending();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(values.data());
+    for (auto value : values) {
+      assertAlways(value % 2 == 0 || value > 0, "odd values must be positive");
+    }
+  }
+  state.bytesProcessed = state.iterations * elements * sizeof(int);
+}
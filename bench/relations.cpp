@@ -0,0 +1,48 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <string>
+#include <vector>
+
+ERRANTIBUS_BENCHMARK(assertEqLargeString) {
+  auto a = std::string(4096, 'x');
+  auto b = a;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(a);
+    assertAlwaysEq(a, b, "strings must match");
+  }
+  state.bytesProcessed = state.iterations * a.size();
+}
+
+ERRANTIBUS_BENCHMARK(assertEqLargeVector) {
+  auto a = std::vector<int>(1024, 7);
+  auto b = a;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(a);
+    assertAlwaysEq(a, b, "vectors must match");
+  }
+  state.bytesProcessed = state.iterations * a.size() * sizeof(int);
+}
+
+ERRANTIBUS_BENCHMARK(assertLtStrings) {
+  auto a = std::string(256, 'a');
+  auto b = std::string(256, 'b');
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(a);
+    assertAlwaysLt(a, b, "must be ordered");
+  }
+}
+
+ERRANTIBUS_BENCHMARK(assertNearDoubles) {
+  double x = 1.0;
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(x);
+    assertAlwaysNear(x, 1.0 + 1e-12, 1e-9, "must be close");
+  }
+}
@@ -0,0 +1,67 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/// Input of a binary search, whose sortedness is the O(n) invariant checked.
+auto sortedValues() -> std::vector<int> {
+  auto values = std::vector<int>(4096);
+  std::iota(values.begin(), values.end(), 0);
+  return values;
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(lookupUnchecked) {
+  auto values = sortedValues();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto key = static_cast<int>(i % values.size());
+    errantibus::bench::doNotOptimize(
+        std::lower_bound(values.begin(), values.end(), key));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(lookupAssertAlways) {
+  auto values = sortedValues();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    assertAlways(std::is_sorted(values.begin(), values.end()), "not sorted");
+    auto key = static_cast<int>(i % values.size());
+    errantibus::bench::doNotOptimize(
+        std::lower_bound(values.begin(), values.end(), key));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(lookupAssertSampled) {
+  auto values = sortedValues();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    assertSampled(std::is_sorted(values.begin(), values.end()), 1000,
+                  "not sorted");
+    auto key = static_cast<int>(i % values.size());
+    errantibus::bench::doNotOptimize(
+        std::lower_bound(values.begin(), values.end(), key));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(lookupAssertEvery) {
+  auto values = sortedValues();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    assertEvery(std::is_sorted(values.begin(), values.end()), 1ms,
+                "not sorted");
+    auto key = static_cast<int>(i % values.size());
+    errantibus::bench::doNotOptimize(
+        std::lower_bound(values.begin(), values.end(), key));
+  }
+}
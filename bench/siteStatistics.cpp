@@ -0,0 +1,40 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#define ERRANTIBUS_SITE_STATISTICS
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <vector>
+
+namespace {
+
+[[gnu::noinline]] auto checkedSum(const std::vector<int> &values) -> long {
+  long sum = 0;
+  for (int value : values) {
+    assertAlways(value >= 0, "values are non-negative");
+    sum += value;
+  }
+  return sum;
+}
+
+void sumRepeatedly(errantibus::bench::State &state) {
+  auto values = std::vector<int>(1024, 1);
+  for (std::size_t i = 0; i < state.iterations; i += values.size()) {
+    errantibus::bench::doNotOptimize(checkedSum(values));
+  }
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(assertCounted) { sumRepeatedly(state); }
+
+ERRANTIBUS_BENCHMARK(assertCountedSampled) {
+  errantibus::setCycleSampling(1024);
+  sumRepeatedly(state);
+  errantibus::setCycleSampling(0);
+}
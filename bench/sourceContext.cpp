@@ -0,0 +1,97 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+#include "sourceCache.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t generatedLines = 20000;
+constexpr std::size_t framesPerReport = 10;
+
+/// A large generated translation unit, removed again at exit.
+auto generatedFile() -> const std::string & {
+  static const auto path = [] {
+    auto name = std::string("/tmp/errantibus-bench-XXXXXX");
+    int fd = mkstemp(name.data());
+    close(fd);
+    auto out = std::ofstream(name);
+    for (std::size_t i = 0; i < generatedLines; ++i) {
+      out << "  static constexpr int generated" << i << " = " << i * 7
+          << "; // filler to make lines a realistic length\n";
+    }
+    std::atexit([] { unlink(generatedFile().c_str()); });
+    return name;
+  }();
+  return path;
+}
+
+/// What printSourceContext did before the cache: a fresh stream per frame.
+auto loadWithStream(const std::string &filename, std::int64_t lineNo)
+    -> std::vector<std::string> {
+  auto lines = std::vector<std::string>();
+  auto file = std::ifstream{filename};
+  for (std::int64_t l = 1; l < lineNo - 2; ++l) {
+    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  for (std::int64_t l = lineNo - 2; l < lineNo + 2 && file; ++l) {
+    auto line = std::string();
+    std::getline(file, line);
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+auto frameLine(std::size_t frame) -> std::int64_t {
+  return static_cast<std::int64_t>(generatedLines - 100 * (frame + 1));
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(sourceContextReportIfstream) {
+  const auto &file = generatedFile();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    for (std::size_t frame = 0; frame < framesPerReport; ++frame) {
+      errantibus::bench::doNotOptimize(loadWithStream(file, frameLine(frame)));
+    }
+  }
+}
+
+ERRANTIBUS_BENCHMARK(sourceContextReportCold) {
+  const auto &file = generatedFile();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto cache = errantibus::internal::SourceCache();
+    for (std::size_t frame = 0; frame < framesPerReport; ++frame) {
+      auto source = cache.open(file);
+      auto loc = static_cast<std::size_t>(frameLine(frame));
+      for (auto l = loc - 2; l < loc + 2; ++l) {
+        errantibus::bench::doNotOptimize(source->line(l));
+      }
+    }
+  }
+}
+
+ERRANTIBUS_BENCHMARK(sourceContextReportCached) {
+  const auto &file = generatedFile();
+  auto &cache = errantibus::internal::SourceCache::instance();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    for (std::size_t frame = 0; frame < framesPerReport; ++frame) {
+      auto source = cache.open(file);
+      auto loc = static_cast<std::size_t>(frameLine(frame));
+      for (auto l = loc - 2; l < loc + 2; ++l) {
+        errantibus::bench::doNotOptimize(source->line(l));
+      }
+    }
+  }
+}
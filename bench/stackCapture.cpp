@@ -0,0 +1,61 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus/stackCapture.hpp>
+
+#include <boost/stacktrace/stacktrace.hpp>
+
+#include <array>
+#include <cstddef>
+
+/*
+ * Each capture happens below the same number of extra frames, so that the
+ * walk has some depth to cover. With ERRANTIBUS_FRAME_POINTERS, captureStack
+ * walks the frame pointers, and otherwise it uses the same unwinder as
+ * Boost, without its allocation.
+ */
+namespace {
+
+constexpr int callDepth = 16;
+
+template <typename Capture>
+[[gnu::noinline]] auto atDepth(int depth, Capture &capture) -> std::size_t {
+  if (depth == 0) {
+    return capture();
+  }
+  auto result = atDepth(depth - 1, capture);
+  errantibus::bench::clobberMemory();
+  return result;
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(captureStack) {
+  auto frames = std::array<const void *, 64>();
+  auto capture = [&] { return errantibus::captureStack(frames); };
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(atDepth(callDepth, capture));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(captureBacktrace) {
+  auto capture = [] {
+    auto trace = errantibus::captureBacktrace();
+    errantibus::bench::doNotOptimize(trace);
+    return trace.frames().size();
+  };
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(atDepth(callDepth, capture));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(captureBoostStacktrace) {
+  auto capture = [] { return boost::stacktrace::stacktrace().size(); };
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(atDepth(callDepth, capture));
+  }
+}
@@ -0,0 +1,59 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+
+#include <errantibus.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+auto sortedValues() -> std::vector<int> {
+  auto values = std::vector<int>(4096);
+  std::iota(values.begin(), values.end(), 0);
+  return values;
+}
+
+/// What a lookup compiles to with its assertions compiled out.
+[[gnu::noinline]] auto lookupPlain(const std::vector<int> &values, int key)
+    -> bool {
+  return std::binary_search(values.begin(), values.end(), key);
+}
+
+[[gnu::noinline]] auto lookupSwitchable(const std::vector<int> &values,
+                                        int key) -> bool {
+  assertSwitchable("bench", std::is_sorted(values.begin(), values.end()),
+                   "not sorted");
+  return std::binary_search(values.begin(), values.end(), key);
+}
+
+template <auto Lookup>
+void lookupRepeatedly(errantibus::bench::State &state) {
+  auto values = sortedValues();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto key = static_cast<int>(i % values.size());
+    errantibus::bench::doNotOptimize(Lookup(values, key));
+  }
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(switchableCompiledOut) {
+  lookupRepeatedly<lookupPlain>(state);
+}
+
+ERRANTIBUS_BENCHMARK(switchableOff) {
+  errantibus::resetAssertions();
+  lookupRepeatedly<lookupSwitchable>(state);
+}
+
+ERRANTIBUS_BENCHMARK(switchableOn) {
+  errantibus::enableAssertions("tag:bench");
+  lookupRepeatedly<lookupSwitchable>(state);
+  errantibus::resetAssertions();
+}
@@ -0,0 +1,84 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "harness.hpp"
+#include "symbolizer.hpp"
+
+#include <boost/stacktrace/stacktrace.hpp>
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int traceDepth = 40;
+
+[[gnu::noinline]] auto captureAt(int depth) -> boost::stacktrace::stacktrace {
+  if (depth == 0) {
+    return boost::stacktrace::stacktrace();
+  }
+  auto trace = captureAt(depth - 1);
+  errantibus::bench::clobberMemory();
+  return trace;
+}
+
+auto deepTrace() -> const std::vector<const void *> & {
+  static auto addresses = [] {
+    auto result = std::vector<const void *>();
+    for (const auto &frame : captureAt(traceDepth)) {
+      result.push_back(frame.address());
+    }
+    return result;
+  }();
+  return addresses;
+}
+
+/// The work the failure path did per frame before batching.
+auto formatWithBoost(const std::vector<const void *> &addresses)
+    -> std::string {
+  auto out = std::ostringstream();
+  for (const auto *address : addresses) {
+    auto frame = boost::stacktrace::frame(address);
+    out << frame.name() << ' ' << frame.source_file() << ':'
+        << frame.source_line() << '\n';
+  }
+  return out.str();
+}
+
+auto formatWith(errantibus::internal::Symbolizer &symbolizer,
+                const std::vector<const void *> &addresses) -> std::string {
+  auto out = std::ostringstream();
+  for (const auto &symbol : symbolizer.resolve(addresses)) {
+    out << symbol->name << ' ' << symbol->file << ':' << symbol->line << '\n';
+  }
+  return out.str();
+}
+
+} // namespace
+
+ERRANTIBUS_BENCHMARK(symbolizeTracePerFrameAddr2line) {
+  const auto &addresses = deepTrace();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(formatWithBoost(addresses));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(symbolizeTraceBatchedCold) {
+  const auto &addresses = deepTrace();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    auto symbolizer = errantibus::internal::Symbolizer();
+    errantibus::bench::doNotOptimize(formatWith(symbolizer, addresses));
+  }
+}
+
+ERRANTIBUS_BENCHMARK(symbolizeTraceBatchedCached) {
+  const auto &addresses = deepTrace();
+  auto &symbolizer = errantibus::internal::Symbolizer::instance();
+  for (std::size_t i = 0; i < state.iterations; ++i) {
+    errantibus::bench::doNotOptimize(formatWith(symbolizer, addresses));
+  }
+}
@@ -4,6 +4,7 @@
  */
 
 #ifndef ERRANTIBUS_LIB_ERRANTIBUS_HPP
+#define ERRANTIBUS_LIB_ERRANTIBUS_HPP
 
 #ifndef ERRANTIBUS_NODEBUG
 
@@ -0,0 +1,152 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_ASYNC_ASSERT_HPP
+#define ERRANTIBUS_ASYNC_ASSERT_HPP
+
+#include "errantibus/asyncDebug.hpp"
+#include "errantibus/stackCapture.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace errantibus {
+
+struct AsyncAssertOptions {
+  /// Worker threads; zero uses one per hardware thread.
+  std::size_t threads = 0;
+  /// How many verifications may wait for a worker, across all of them.
+  std::size_t queueCapacity = 1024;
+  /// What `assertAsync` does when the queue is full. Dropped verifications
+  /// are counted, see droppedAsyncAssertions().
+  OverflowPolicy overflow = OverflowPolicy::block;
+};
+
+/**
+ * @brief Start the verification pool: `assertAsync` then only hands its
+ * snapshot to a worker, which evaluates the predicate and reports a failure
+ * with the stack of the original call.
+ */
+void enableAsyncAssertions(const AsyncAssertOptions &options = {});
+
+/**
+ * @brief Verify everything still queued, stop the workers and return to
+ * evaluating `assertAsync` on the calling thread.
+ */
+void disableAsyncAssertions();
+
+/**
+ * @brief Block until every verification queued so far has been evaluated.
+ */
+void flushAsyncAssertions();
+
+/**
+ * @brief Number of verifications skipped under OverflowPolicy::drop.
+ */
+auto droppedAsyncAssertions() -> std::uint64_t;
+
+} // namespace errantibus
+
+namespace errantibus::internal {
+
+/**
+ * @brief Where an asynchronous assertion was made: the stack and thread of
+ * its call, for the report.
+ */
+struct AsyncOrigin {
+  Backtrace stack;
+  std::uint64_t thread = 0;
+};
+
+/**
+ * @brief A queued verification. `run` evaluates it, reports a failure, and
+ * frees it.
+ */
+struct Verification {
+  void (*run)(Verification *self);
+  AsyncOrigin origin;
+};
+
+enum class Admission {
+  inactive, ///< The pool is not running; verify on the calling thread.
+  admitted, ///< Queue the verification with submitVerification().
+  dropped,  ///< The queue is full; skip the verification.
+};
+
+/**
+ * @brief Reserve a place in the queue, waiting for one under
+ * OverflowPolicy::block.
+ */
+auto admitVerification() -> Admission;
+
+/**
+ * @brief Give up a place that admitVerification() reserved.
+ */
+void cancelVerification();
+
+/**
+ * @brief Queue an admitted verification. The pool takes ownership.
+ */
+void submitVerification(Verification *verification);
+
+template <typename Snapshot, typename Predicate, typename Fail>
+struct PendingVerification : Verification {
+  Snapshot snapshot;
+  Predicate predicate;
+  Fail fail;
+
+  static void run(Verification *self) {
+    auto owned = std::unique_ptr<PendingVerification>(
+        static_cast<PendingVerification *>(self));
+    if (!std::invoke(owned->predicate, std::as_const(owned->snapshot))) {
+      owned->fail(&owned->origin);
+    }
+  }
+};
+
+/**
+ * @brief Verify `predicate(snapshot)` on the pool if it is running, and
+ * right away otherwise. `makeFail()` returns what reports a failure, which
+ * is passed the origin of the call, or nullptr if the verification ran
+ * where it was made. It is only called when the verification is queued or
+ * has failed, so that what it copies is not copied on every call.
+ */
+template <typename Snapshot, typename Predicate, typename MakeFail>
+[[gnu::noinline]] void verifyAsync(Snapshot &&snapshot, Predicate &&predicate,
+                                   MakeFail &&makeFail) {
+  switch (admitVerification()) {
+  case Admission::inactive:
+    if (!std::invoke(predicate, std::as_const(snapshot))) {
+      makeFail()(nullptr);
+    }
+    return;
+  case Admission::dropped:
+    return;
+  case Admission::admitted:
+    break;
+  }
+  using Pending =
+      PendingVerification<std::decay_t<Snapshot>, std::decay_t<Predicate>,
+                          std::invoke_result_t<MakeFail &>>;
+  Pending *pending = nullptr;
+  try {
+    // Skip this frame, the stack starts at the assertion.
+    pending = new Pending{{Pending::run, {captureBacktrace(1)}},
+                          std::forward<Snapshot>(snapshot),
+                          std::forward<Predicate>(predicate), makeFail()};
+  } catch (...) {
+    cancelVerification();
+    throw;
+  }
+  submitVerification(pending);
+}
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_ASYNC_ASSERT_HPP
@@ -0,0 +1,124 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_ASYNC_DEBUG_HPP
+#define ERRANTIBUS_ASYNC_DEBUG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace errantibus {
+
+/**
+ * @brief What `debug(...)` does when its thread's buffer is full.
+ */
+enum class OverflowPolicy {
+  drop,  ///< Discard the message and count it, see droppedDebugMessages().
+  block, ///< Wait until the background thread has made room.
+};
+
+struct AsyncDebugOptions {
+  /// Size of each thread's ring buffer, rounded up to a power of two.
+  /// Messages larger than half of it are dropped under either policy.
+  std::size_t bufferBytes = std::size_t{1} << 16;
+  OverflowPolicy overflow = OverflowPolicy::drop;
+  /// How long the background thread sleeps when all buffers are empty.
+  std::chrono::microseconds pollInterval{1000};
+};
+
+/**
+ * @brief Switch `debug(...)` to asynchronous mode: calls only copy their
+ * arguments into a per-thread lock-free ring buffer, and a background
+ * thread formats and writes them to stderr in batches.
+ */
+void enableAsyncDebug(const AsyncDebugOptions &options = {});
+
+/**
+ * @brief Print everything still buffered, stop the background thread and
+ * return to synchronous `debug(...)`.
+ */
+void disableAsyncDebug();
+
+/**
+ * @brief Block until everything buffered so far has been written.
+ */
+void flushAsyncDebug();
+
+/**
+ * @brief Number of messages discarded under OverflowPolicy::drop.
+ */
+auto droppedDebugMessages() -> std::uint64_t;
+
+} // namespace errantibus
+
+namespace errantibus {
+
+class Writer;
+
+} // namespace errantibus
+
+namespace errantibus::internal {
+
+/**
+ * @brief Static description of a `debug(...)` call site. Records refer to
+ * their site by address instead of copying file and expression names.
+ */
+struct DebugSite {
+  const char *file;
+  std::size_t line;
+  std::span<const std::string_view> expressions;
+};
+
+/**
+ * @brief Turns the bytes an argument was encoded to back into text.
+ */
+using Decoder = void (*)(Writer &out, const std::byte *data,
+                         std::size_t size);
+
+extern std::atomic<bool> asyncDebugActive;
+
+inline auto asyncDebugEnabled() -> bool {
+  return asyncDebugActive.load(std::memory_order_relaxed);
+}
+
+/// Records and arguments in the ring buffers start at this alignment.
+constexpr std::size_t recordAlignment = 16;
+
+constexpr auto alignRecord(std::size_t size) -> std::size_t {
+  return (size + recordAlignment - 1) & ~(recordAlignment - 1);
+}
+
+struct RecordHeader {
+  const DebugSite *site; ///< nullptr marks padding up to the buffer's end
+  std::uint32_t size;    ///< including this header
+  std::uint32_t argumentCount;
+};
+
+struct ArgumentHeader {
+  Decoder decoder;
+  std::uint64_t size; ///< of the payload that follows, before alignment
+};
+
+static_assert(sizeof(RecordHeader) == recordAlignment);
+static_assert(sizeof(ArgumentHeader) == recordAlignment);
+
+/**
+ * @brief Reserve `size` bytes (a multiple of recordAlignment) in the calling
+ * thread's ring buffer. Returns nullptr if the message has to be dropped.
+ */
+auto reserveDebugRecord(std::size_t size) -> std::byte *;
+
+/**
+ * @brief Publish the record returned by the last reserveDebugRecord().
+ */
+void commitDebugRecord(std::size_t size);
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_ASYNC_DEBUG_HPP
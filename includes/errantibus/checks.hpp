@@ -0,0 +1,160 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_CHECKS_HPP
+#define ERRANTIBUS_CHECKS_HPP
+
+#include "errantibus/output.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace errantibus {
+
+/**
+ * @brief A failed `check*`, as passed to the check handler.
+ */
+struct CheckFailure {
+  const char *file;
+  std::uint32_t line;
+  const char *condition;
+  std::string_view message;
+  /// The full report with values and stack trace, or nullptr if this
+  /// failure was only counted.
+  const Entry *entry;
+  /// How often this check has failed so far, this time included.
+  std::uint64_t failures;
+  /// If the failures of this check are due for a summary, how many went
+  /// unreported since the last one; otherwise zero.
+  std::uint64_t unreported;
+};
+
+/**
+ * @brief Called for every failed check, also for those that are only
+ * counted. It may throw, which the failing check passes on.
+ */
+using CheckHandler = void (*)(const CheckFailure &failure);
+
+/**
+ * @brief The default handler: writes full reports and summaries to the
+ * output configured with setOutput, stderr by default.
+ */
+void logCheckFailure(const CheckFailure &failure);
+
+/**
+ * @brief Throws a CheckError for every failure.
+ */
+void throwCheckFailure(const CheckFailure &failure);
+
+/**
+ * @brief Does nothing but let the failure be counted, see checkStatistics.
+ */
+void countCheckFailure(const CheckFailure &failure);
+
+/**
+ * @brief Thrown by throwCheckFailure. `what()` is the full report if there
+ * is one, with the stack trace last, and the position and message of the
+ * check otherwise.
+ */
+class CheckError : public std::runtime_error {
+public:
+  explicit CheckError(const CheckFailure &failure);
+};
+
+struct CheckOptions {
+  CheckHandler handler = logCheckFailure;
+  /// How many failures of each check are reported in full.
+  std::uint32_t fullReports = 10;
+  /// How often the further failures of a check are summarized.
+  std::chrono::milliseconds summaryInterval = std::chrono::seconds(60);
+};
+
+/**
+ * @brief Configure how failed checks are handled. A null handler counts
+ * failures like countCheckFailure.
+ */
+void setCheckOptions(const CheckOptions &options);
+
+/**
+ * @brief How often one check has failed.
+ */
+struct CheckStatistics {
+  const char *file;
+  std::uint32_t line;
+  const char *condition;
+  std::uint64_t failures;
+};
+
+/**
+ * @brief Summarize every check with failures that have not been reported
+ * yet, without waiting for the summary interval. This also happens when
+ * the process exits normally.
+ */
+void flushCheckSummaries();
+
+/**
+ * @brief Every check that has failed at least once, most failures first.
+ * Summaries that are due are passed to the handler first, so that failures
+ * are not left unsummarized when a check stops failing.
+ */
+auto checkStatistics() -> std::vector<CheckStatistics>;
+
+} // namespace errantibus
+
+namespace errantibus::internal {
+
+/**
+ * @brief Failure state of one `check*` call site. It only exists in the
+ * failure branch, and all of it is updated with single atomic operations,
+ * so threads failing the same check never wait for each other.
+ */
+struct CheckSite {
+  const char *file;
+  const char *condition;
+  std::uint32_t line;
+  std::atomic<std::uint64_t> failures = 0;
+  /// The failure count up to which failures have been reported.
+  std::atomic<std::uint64_t> reported = 0;
+  /// When the last report or summary was written, in steady clock ticks.
+  std::atomic<std::int64_t> lastReport = 0;
+  /// Sites are listed once they first fail.
+  CheckSite *next = nullptr;
+};
+
+/**
+ * @brief Count a failure of `site`. If it is to be reported in full,
+ * returns its number and leaves the report to the caller; otherwise passes
+ * it to the handler right away and returns zero.
+ */
+auto beginCheckFailure(CheckSite &site, std::string_view message)
+    -> std::uint64_t;
+
+/**
+ * @brief Pass a fully reported failure to the handler.
+ */
+void endCheckFailure(CheckSite &site, std::string_view message,
+                     std::uint64_t number, Entry entry);
+
+} // namespace errantibus::internal
+
+/**
+ * Like ERRANTIBUS_COLD_THUNK, but for a failure branch that returns.
+ */
+#define ERRANTIBUS_CHECK_THUNK [&] [[gnu::cold, gnu::noinline]]
+
+/**
+ * Declares the failure state of a check. Only used inside the failure
+ * branch, so that the state is not touched while the check passes.
+ */
+#define ERRANTIBUS_CHECK_SITE(site, condition)                                 \
+  static constinit errantibus::internal::CheckSite site {                      \
+    __FILE__, condition, __LINE__                                              \
+  }
+
+#endif // !ERRANTIBUS_CHECKS_HPP
@@ -0,0 +1,32 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_CRASH_RECORD_HPP
+#define ERRANTIBUS_CRASH_RECORD_HPP
+
+#include <string>
+
+namespace errantibus {
+
+/**
+ * @brief On failure, skip symbolizing the stack trace and reading sources.
+ * Instead, write the raw return addresses, the loaded modules with their
+ * build-ids and the formatted report to `path`, and terminate right away.
+ * `%p` in `path` is replaced by the process id. The record is printed
+ * later with the `errantibus_symbolize` tool.
+ *
+ * Without a call to this function, the environment variable
+ * `ERRANTIBUS_CRASH_RECORD` is used as the path, if it is set.
+ */
+void enableCrashRecords(const std::string &path);
+
+/**
+ * @brief Go back to printing the full report on failure.
+ */
+void disableCrashRecords();
+
+} // namespace errantibus
+
+#endif // !ERRANTIBUS_CRASH_RECORD_HPP
@@ -0,0 +1,252 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_EXPRESSIONS_HPP
+#define ERRANTIBUS_EXPRESSIONS_HPP
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+
+namespace errantibus::internal {
+
+/**
+ * @brief A string literal usable as a template argument.
+ */
+template <std::size_t N>
+struct FixedString {
+  char data[N]{};
+
+  constexpr FixedString(const char (&text)[N]) { // NOLINT: implicit on purpose
+    for (std::size_t i = 0; i < N; ++i) {
+      data[i] = text[i];
+    }
+  }
+
+  constexpr auto view() const -> std::string_view { return {data, N - 1}; }
+};
+
+constexpr auto isIdentifierChar(char c) -> bool {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+constexpr auto isSpace(char c) -> bool {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+constexpr auto trimExpression(std::string_view sv) -> std::string_view {
+  while (!sv.empty() && isSpace(sv.front())) {
+    sv.remove_prefix(1);
+  }
+  while (!sv.empty() && isSpace(sv.back())) {
+    sv.remove_suffix(1);
+  }
+  return sv;
+}
+
+/**
+ * @brief Index just past the literal that starts with the quote at `i`.
+ */
+constexpr auto skipLiteral(std::string_view text, std::size_t i)
+    -> std::size_t {
+  char quote = text[i];
+  if (quote == '"' && i > 0 && text[i - 1] == 'R') {
+    auto open = text.find('(', i);
+    if (open == std::string_view::npos) {
+      return text.size();
+    }
+    auto delimiter = text.substr(i + 1, open - i - 1);
+    for (auto close = text.find(')', open); close != std::string_view::npos;
+         close = text.find(')', close + 1)) {
+      auto rest = text.substr(close + 1);
+      if (rest.starts_with(delimiter) &&
+          rest.substr(delimiter.size()).starts_with('"')) {
+        return close + delimiter.size() + 2;
+      }
+    }
+    return text.size();
+  }
+  for (++i; i < text.size(); ++i) {
+    if (text[i] == '\\') {
+      ++i;
+    } else if (text[i] == quote) {
+      return i + 1;
+    }
+  }
+  return text.size();
+}
+
+/**
+ * @brief Index just past the preprocessing number that starts at `i`.
+ * Digit separators (`1'000`) must not be mistaken for character literals.
+ */
+constexpr auto skipNumber(std::string_view text, std::size_t i) -> std::size_t {
+  for (++i; i < text.size(); ++i) {
+    char c = text[i];
+    char previous = text[i - 1];
+    bool exponentSign = (c == '+' || c == '-') &&
+                        (previous == 'e' || previous == 'E' ||
+                         previous == 'p' || previous == 'P');
+    if (!isIdentifierChar(c) && c != '.' && c != '\'' && !exponentSign) {
+      break;
+    }
+  }
+  return i;
+}
+
+/**
+ * @brief Split the stringified argument list of a macro into pieces at the
+ * commas outside of brackets and literals, calling `emit` for each.
+ *
+ * Commas inside `()`, `{}` or `[]` never separate the arguments of a
+ * function call, so these are nested. Commas inside template arguments do,
+ * to the preprocessor and here; splitExpressions joins those pieces again.
+ */
+template <typename Emit>
+constexpr void forEachExpression(std::string_view text, Emit emit) {
+  if (trimExpression(text).empty()) {
+    return;
+  }
+  std::size_t start = 0;
+  std::size_t depth = 0;
+  std::size_t i = 0;
+  while (i < text.size()) {
+    char c = text[i];
+    bool atTokenStart = i == 0 || !isIdentifierChar(text[i - 1]);
+    if (c == '"' || c == '\'') {
+      i = skipLiteral(text, i);
+      continue;
+    }
+    if (c >= '0' && c <= '9' && atTokenStart) {
+      i = skipNumber(text, i);
+      continue;
+    }
+    if (c == '(' || c == '{' || c == '[') {
+      ++depth;
+    } else if ((c == ')' || c == '}' || c == ']') && depth > 0) {
+      --depth;
+    } else if (c == ',' && depth == 0) {
+      emit(trimExpression(text.substr(start, i - start)));
+      start = i + 1;
+    }
+    ++i;
+  }
+  emit(trimExpression(text.substr(start)));
+}
+
+/**
+ * @brief How many more `<` than `>` there are in `text`, outside of
+ * literals and not counting the `>` of `->`.
+ */
+constexpr auto openAngles(std::string_view text) -> std::ptrdiff_t {
+  std::ptrdiff_t open = 0;
+  std::size_t i = 0;
+  while (i < text.size()) {
+    char c = text[i];
+    bool atTokenStart = i == 0 || !isIdentifierChar(text[i - 1]);
+    if (c == '"' || c == '\'') {
+      i = skipLiteral(text, i);
+      continue;
+    }
+    if (c >= '0' && c <= '9' && atTokenStart) {
+      i = skipNumber(text, i);
+      continue;
+    }
+    if (c == '<') {
+      ++open;
+    } else if (c == '>' && (i == 0 || text[i - 1] != '-')) {
+      --open;
+    }
+    ++i;
+  }
+  return open;
+}
+
+/**
+ * @brief The `Count` argument names in `text`. If it splits into more
+ * pieces, the surplus commas are those inside template arguments: a piece
+ * that leaves a `<` open is joined with the next one, until the pieces
+ * match the arguments.
+ */
+template <std::size_t Count>
+constexpr auto splitExpressions(std::string_view text)
+    -> std::array<std::string_view, Count> {
+  std::size_t pieces = 0;
+  forEachExpression(text, [&](std::string_view) { ++pieces; });
+  std::size_t surplus = pieces > Count ? pieces - Count : 0;
+
+  auto result = std::array<std::string_view, Count>();
+  std::size_t index = 0;
+  auto add = [&](std::string_view expression) {
+    if (index < Count) {
+      result[index] = expression;
+    }
+    ++index;
+  };
+  auto joined = std::string_view();
+  forEachExpression(text, [&](std::string_view piece) {
+    if (!joined.empty()) {
+      auto end = piece.data() + piece.size();
+      piece = {joined.data(), static_cast<std::size_t>(end - joined.data())};
+    }
+    if (surplus > 0 && openAngles(piece) > 0) {
+      joined = piece;
+      --surplus;
+      return;
+    }
+    joined = {};
+    add(piece);
+  });
+  if (!joined.empty()) {
+    add(joined);
+  }
+  return result;
+}
+
+static_assert(splitExpressions<2>("a, b") ==
+              std::array<std::string_view, 2>{"a", "b"});
+static_assert(splitExpressions<1>("std::pair<int,int>{1,2}")[0] ==
+              "std::pair<int,int>{1,2}");
+static_assert(splitExpressions<3>("x, std::vector<int>{1, 2, 3}, y") ==
+              std::array<std::string_view, 3>{
+                  "x", "std::vector<int>{1, 2, 3}", "y"});
+static_assert(splitExpressions<2>("[a, b] { return a < b; }, c") ==
+              std::array<std::string_view, 2>{"[a, b] { return a < b; }",
+                                              "c"});
+static_assert(splitExpressions<2>("std::map<int, std::pair<int, int>>{}, n") ==
+              std::array<std::string_view, 2>{
+                  "std::map<int, std::pair<int, int>>{}", "n"});
+static_assert(splitExpressions<2>("a < b, c > d") ==
+              std::array<std::string_view, 2>{"a < b", "c > d"});
+
+/**
+ * @brief The names of a macro's extra arguments, parsed at compile time and
+ * stored as static data. `Count` is the number of arguments the compiler
+ * saw, which the names are made to match.
+ */
+template <FixedString Text, std::size_t Count>
+struct Expressions {
+  static constexpr std::array<std::string_view, Count> names =
+      splitExpressions<Count>(Text.view());
+};
+
+/**
+ * @brief Only used unevaluated, to count the arguments of a macro.
+ */
+template <typename... Args>
+auto countArguments(const Args &...)
+    -> std::integral_constant<std::size_t, sizeof...(Args)>;
+
+} // namespace errantibus::internal
+
+#define ERRANTIBUS_EXPRESSIONS(...)                                            \
+  errantibus::internal::Expressions<                                           \
+      #__VA_ARGS__, decltype(errantibus::internal::countArguments(             \
+                        __VA_ARGS__))::value>::names
+
+#endif // !ERRANTIBUS_EXPRESSIONS_HPP
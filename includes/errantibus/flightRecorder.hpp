@@ -0,0 +1,81 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_FLIGHT_RECORDER_HPP
+#define ERRANTIBUS_FLIGHT_RECORDER_HPP
+
+#include "errantibus/asyncDebug.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace errantibus {
+
+/**
+ * @brief Number of `errantibusRecord(...)` events each thread keeps; older
+ * ones are overwritten. Applies to threads that record their first event
+ * afterwards, and 0 turns recording off for them.
+ */
+void setFlightRecorderDepth(std::size_t events);
+
+/**
+ * @brief Write the recorded events of all threads to `out`, oldest first.
+ * Failing assertions do this on their own, next to the stack trace.
+ */
+void dumpFlightRecorder(std::ostream &out);
+
+} // namespace errantibus
+
+namespace errantibus::internal {
+
+/// Size of an event, including its arguments. Arguments that do not fit
+/// are shown as too large.
+constexpr std::size_t flightSlotBytes = 256;
+
+/**
+ * @brief One event. `record` holds a RecordHeader and the arguments, just
+ * like a record of the async `debug(...)` buffers. `sequence` is odd while
+ * the event is being written, so that a failing thread can read the slots
+ * of all others without stopping them.
+ */
+struct alignas(recordAlignment) FlightSlot {
+  std::atomic<std::uint64_t> sequence = 0;
+  alignas(recordAlignment) std::byte record[flightSlotBytes - recordAlignment];
+};
+
+static_assert(sizeof(FlightSlot) == flightSlotBytes);
+
+/// Arguments a single event can hold, with nothing but their headers.
+constexpr std::size_t maxFlightArguments =
+    (sizeof(FlightSlot::record) - sizeof(RecordHeader)) /
+    sizeof(ArgumentHeader);
+
+/**
+ * @brief A thread's ring of events. Only the owning thread writes to it.
+ */
+struct FlightRing {
+  FlightSlot *slots = nullptr;
+  std::uint64_t mask = 0;
+  std::uint64_t next = 0;
+};
+
+inline thread_local FlightRing *localFlightRing = nullptr;
+
+/**
+ * @brief Create the calling thread's ring. Returns nullptr if recording is
+ * off or the thread is already exiting.
+ */
+auto attachFlightRing() -> FlightRing *;
+
+/**
+ * @brief Decoder for arguments that did not fit into their event.
+ */
+void decodeOversized(Writer &out, const std::byte *data, std::size_t size);
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_FLIGHT_RECORDER_HPP
@@ -0,0 +1,214 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_FORMAT_HPP
+#define ERRANTIBUS_FORMAT_HPP
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace errantibus::internal {
+
+/**
+ * @brief Thread-local scratch memory that reports are formatted into.
+ *
+ * The arena is a list of chunks that are kept across reports, so once it
+ * has grown to the size of a typical report, formatting allocates nothing.
+ * A value that does not fit the current chunk moves to the next one as a
+ * whole, so every finished value stays contiguous and never moves again.
+ * Memory is handed back in stack order through mark() and release().
+ * If no memory is left to grow, text that does not fit is dropped, so that
+ * a failure under memory pressure still gets reported.
+ */
+class Arena {
+public:
+  struct Mark {
+    std::size_t chunk = 0;
+    std::size_t offset = 0;
+  };
+
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena(Arena &&) = delete;
+  auto operator=(const Arena &) -> Arena & = delete;
+  auto operator=(Arena &&) -> Arena & = delete;
+  ~Arena() = default;
+
+  /**
+   * @brief The calling thread's arena.
+   */
+  static auto local() -> Arena &;
+
+  auto mark() const -> Mark {
+    return {current, static_cast<std::size_t>(cursor - base)};
+  }
+
+  /**
+   * @brief Free everything allocated after `mark`. Releasing out of order
+   * only ever moves the arena backwards.
+   */
+  void release(Mark mark);
+
+  void beginValue() { valueStart = cursor; }
+
+  auto endValue() const -> std::string_view {
+    return {valueStart, static_cast<std::size_t>(cursor - valueStart)};
+  }
+
+  void append(std::string_view text) {
+    auto room = static_cast<std::size_t>(limit - cursor);
+    if (room < text.size() && !grow(text.size())) {
+      text = text.substr(0, room);
+    }
+    if (text.empty()) {
+      return;
+    }
+    std::memcpy(cursor, text.data(), text.size());
+    cursor += text.size();
+  }
+
+  void append(char c) {
+    if (cursor == limit && !grow(1)) {
+      return;
+    }
+    *cursor++ = c;
+  }
+
+private:
+  struct Chunk {
+    std::unique_ptr<char[]> data;
+    std::size_t size = 0;
+  };
+
+  auto grow(std::size_t needed) -> bool;
+
+  std::vector<Chunk> chunks;
+  std::size_t current = 0;
+  char *base = nullptr;
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  char *valueStart = nullptr;
+};
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+/**
+ * @brief Upper bounds on how much of a single value a report shows, so that
+ * a huge argument cannot make a report slow or run the process out of memory.
+ */
+struct FormatLimits {
+  /// Elements shown per container; the rest is elided from the middle.
+  std::size_t maxElements = 64;
+  /// Containers nested deeper than this are shown as `{...}`.
+  std::size_t maxDepth = 16;
+  /// Text per value, after which the value is cut off.
+  std::size_t maxValueBytes = std::size_t{64} << 10;
+};
+
+/**
+ * @brief Change the limits for all threads. Values that are being formatted
+ * right now keep using the old ones.
+ */
+void setFormatLimits(const FormatLimits &limits);
+
+auto formatLimits() -> FormatLimits;
+
+/**
+ * @brief Output handed to formatting hooks. To control how a type of your
+ * own is shown in reports, declare next to it
+ *
+ *     void errantibusFormat(errantibus::Writer &out, const MyType &value);
+ *
+ * Such a hook takes precedence over `operator<<` and container printing.
+ * Text beyond FormatLimits::maxValueBytes is dropped; long-running hooks
+ * may check exhausted() to stop early.
+ */
+class Writer {
+public:
+  explicit Writer(internal::Arena &arena) :
+      Writer(arena, errantibus::formatLimits()) {}
+  Writer(internal::Arena &arena, const FormatLimits &limits) :
+      arena(arena), bounds(limits), remaining(limits.maxValueBytes) {}
+
+  void append(std::string_view text) {
+    if (text.size() > remaining) {
+      text = text.substr(0, remaining);
+      truncated = true;
+    }
+    remaining -= text.size();
+    arena.append(text);
+  }
+
+  void append(char c) {
+    if (remaining == 0) {
+      truncated = true;
+      return;
+    }
+    --remaining;
+    arena.append(c);
+  }
+
+  template <typename T>
+    requires std::integral<T> || std::floating_point<T>
+  void appendNumber(T value) {
+    char digits[64];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    append(std::string_view(digits, end - digits));
+  }
+
+  /**
+   * @brief Append `obj` the way a report shows it.
+   */
+  template <typename T>
+  void value(const T &obj);
+
+  /**
+   * @brief Whether the value has hit the byte limit.
+   */
+  auto exhausted() const -> bool { return truncated; }
+
+  auto limits() const -> const FormatLimits & { return bounds; }
+
+  /**
+   * @brief Step into a nested container. Returns false, without stepping in,
+   * once the maximum depth is reached.
+   */
+  auto enter() -> bool {
+    if (depth == bounds.maxDepth) {
+      return false;
+    }
+    ++depth;
+    return true;
+  }
+
+  void leave() { --depth; }
+
+  /**
+   * @brief Close the value, marking it if it was cut off.
+   */
+  void finish() {
+    if (truncated) {
+      arena.append(" ... (truncated)");
+    }
+  }
+
+private:
+  internal::Arena &arena;
+  FormatLimits bounds;
+  std::size_t remaining;
+  std::size_t depth = 0;
+  bool truncated = false;
+};
+
+} // namespace errantibus
+
+#endif // !ERRANTIBUS_FORMAT_HPP
@@ -0,0 +1,181 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_OUTPUT_HPP
+#define ERRANTIBUS_OUTPUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace errantibus {
+
+enum class EntryKind : std::uint8_t {
+  failure,  ///< A failed assertion; the program terminates after it.
+  check,    ///< A failed check, reported in full.
+  summary,  ///< Further failures of a check, only counted.
+  debug,    ///< A `debug(...)` message.
+  recorded, ///< An event of the flight recorder, shown with a failure.
+};
+
+enum class OperandRole : std::uint8_t { left, right, tolerance };
+
+/// An operand of a comparing assertion.
+struct Operand {
+  OperandRole role;
+  std::string_view expression;
+  std::string_view value;
+};
+
+/**
+ * @brief The element a range assertion failed at and its neighbours, which
+ * start at index `first`.
+ */
+struct RangeExcerpt {
+  std::size_t size;
+  std::size_t index;
+  std::size_t first;
+  std::span<const std::string_view> values{};
+};
+
+/// A symbolized frame of a stack trace.
+struct Frame {
+  const void *address;
+  std::string_view function;
+  std::string_view file;
+  std::uint32_t line;
+};
+
+/**
+ * @brief One report or message, as it is passed to an encoder. Fields that
+ * do not apply to it are empty. All of them refer to memory of the caller.
+ */
+struct Entry {
+  EntryKind kind = EntryKind::debug;
+  std::string_view file{};
+  std::uint64_t line = 0;
+  std::string_view message{};
+  /// The thread that reported or recorded it.
+  std::uint64_t thread = 0;
+  /// The condition of an assertion without operands.
+  std::string_view condition{};
+  /// What a comparing or range assertion expected.
+  std::string_view expectation{};
+  std::span<const Operand> operands{};
+  /// The range of a range assertion, and where it failed.
+  std::string_view range{};
+  RangeExcerpt excerpt{};
+  /// The extra arguments of the macro, as written and as formatted.
+  std::span<const std::string_view> expressions{};
+  std::span<const std::string_view> values{};
+  /// The stack trace, innermost frame first.
+  std::span<const Frame> frames{};
+  /// For checks and summaries, how often the check has failed so far, and
+  /// for summaries, how many of those went unreported since the last one.
+  std::uint64_t failures = 0;
+  std::uint64_t unreported = 0;
+  /// For recorded events, the number of the event on its thread.
+  std::uint64_t sequence = 0;
+  /// A closing remark, e.g. that further failures are not reported.
+  std::string_view note{};
+};
+
+/**
+ * @brief Appends a batch of entries to `out`. Colors are only wanted if the
+ * output goes to a terminal.
+ */
+using Encoder = void (*)(std::string &out, std::span<const Entry> entries,
+                         bool colors);
+
+/**
+ * @brief The human-readable reports, as printed to a terminal.
+ */
+void encodeText(std::string &out, std::span<const Entry> entries,
+                bool colors);
+
+/**
+ * @brief One JSON object per line and entry. Values are shown as they are
+ * in the text reports.
+ */
+void encodeJsonLines(std::string &out, std::span<const Entry> entries,
+                     bool colors);
+
+/**
+ * @brief Each entry as a little-endian 32-bit length, followed by that many
+ * bytes of tagged fields. `errantibus_decode` turns it back into text or
+ * JSON lines.
+ */
+void encodeBinary(std::string &out, std::span<const Entry> entries,
+                  bool colors);
+
+/**
+ * @brief Where reports and `debug(...)` messages go. Every batch of output
+ * is written in one call, which may come from any thread.
+ */
+class Sink {
+public:
+  using WriteFunction = void (*)(void *context, std::string_view data);
+
+  Sink(WriteFunction write, std::shared_ptr<void> context, bool terminal);
+
+  /// Standard error, the default.
+  static auto standardError() -> Sink;
+  /// An open file descriptor, which stays owned by the caller.
+  static auto fileDescriptor(int fd) -> Sink;
+  /// A file, opened for appending and created if needed. Throws
+  /// std::system_error if it cannot be opened.
+  static auto file(const std::string &path) -> Sink;
+
+  void write(std::string_view data) const { writeData(context.get(), data); }
+  /// Whether the sink is a terminal, which is where colors are shown.
+  auto terminal() const -> bool { return isTerminal; }
+
+private:
+  WriteFunction writeData;
+  std::shared_ptr<void> context;
+  bool isTerminal;
+};
+
+/**
+ * @brief Collects output in memory, e.g. to inspect it in tests.
+ */
+class MemorySink {
+public:
+  MemorySink();
+
+  auto sink() const -> Sink;
+  auto contents() const -> std::string;
+  void clear();
+
+private:
+  struct Buffer;
+  std::shared_ptr<Buffer> buffer;
+};
+
+enum class ColorMode : std::uint8_t {
+  automatic, ///< Only if the sink is a terminal.
+  always,
+  never,
+};
+
+struct OutputOptions {
+  Sink sink = Sink::standardError();
+  Encoder encoder = encodeText;
+  ColorMode colors = ColorMode::automatic;
+};
+
+/**
+ * @brief Send reports and `debug(...)` messages to another sink or in
+ * another encoding. Reports written on the emergency path, when memory has
+ * run out or from a signal handler, always go to stderr as text.
+ */
+void setOutput(const OutputOptions &options);
+
+} // namespace errantibus
+
+#endif // !ERRANTIBUS_OUTPUT_HPP
@@ -0,0 +1,241 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_RANGES_HPP
+#define ERRANTIBUS_RANGES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+namespace errantibus::internal {
+
+/// Returned by the range searches if every element passed.
+constexpr std::size_t noIndex = std::numeric_limits<std::size_t>::max();
+
+/*
+ * Vectorized searches over contiguous arrays of the common arithmetic types.
+ * Each returns the index of the first offending element, or noIndex.
+ */
+
+#define ERRANTIBUS_DECLARE_RANGE_KERNELS(T)                                    \
+  auto firstOutOfRange(const T *data, std::size_t size, T lo, T hi)            \
+      -> std::size_t;                                                          \
+  auto firstUnsorted(const T *data, std::size_t size) -> std::size_t
+
+ERRANTIBUS_DECLARE_RANGE_KERNELS(int);
+ERRANTIBUS_DECLARE_RANGE_KERNELS(unsigned);
+ERRANTIBUS_DECLARE_RANGE_KERNELS(long);
+ERRANTIBUS_DECLARE_RANGE_KERNELS(unsigned long);
+ERRANTIBUS_DECLARE_RANGE_KERNELS(long long);
+ERRANTIBUS_DECLARE_RANGE_KERNELS(unsigned long long);
+ERRANTIBUS_DECLARE_RANGE_KERNELS(float);
+ERRANTIBUS_DECLARE_RANGE_KERNELS(double);
+
+#undef ERRANTIBUS_DECLARE_RANGE_KERNELS
+
+auto firstNaN(const float *data, std::size_t size) -> std::size_t;
+auto firstNaN(const double *data, std::size_t size) -> std::size_t;
+
+template <typename T>
+concept KernelElement =
+    std::same_as<T, int> || std::same_as<T, unsigned> ||
+    std::same_as<T, long> || std::same_as<T, unsigned long> ||
+    std::same_as<T, long long> || std::same_as<T, unsigned long long> ||
+    std::same_as<T, float> || std::same_as<T, double>;
+
+template <typename Range>
+using RangeElement = std::remove_cv_t<std::ranges::range_value_t<Range>>;
+
+/// A range the kernels can search directly.
+template <typename Range>
+concept KernelRange = std::ranges::contiguous_range<const Range> &&
+                      std::ranges::sized_range<const Range> &&
+                      KernelElement<RangeElement<Range>>;
+
+template <typename Range>
+concept FlatRange = std::ranges::contiguous_range<const Range> &&
+                    std::ranges::sized_range<const Range>;
+
+/**
+ * @brief `a <= b`, also for integers of different signedness.
+ */
+template <typename A, typename B>
+constexpr auto lessEqual(const A &a, const B &b) -> bool {
+  if constexpr (std::is_integral_v<A> && std::is_integral_v<B> &&
+                std::is_signed_v<A> != std::is_signed_v<B>) {
+    return std::cmp_less_equal(a, b);
+  } else {
+    return a <= b;
+  }
+}
+
+/**
+ * @brief Index of the first element for which `predicate` is false, or
+ * noIndex.
+ *
+ * Arrays of numbers are searched in blocks that evaluate the predicate
+ * without branching, so that simple predicates are vectorized. Within the
+ * block that fails, the predicate is thus also called for the elements after
+ * the first failing one, though for none of them twice. Other ranges are
+ * searched one element at a time, like std::all_of, so that a predicate that
+ * relies on the elements before, like a null check, is never called past the
+ * first failure.
+ */
+template <typename Range, typename Predicate>
+auto findFirstFailing(const Range &range, Predicate &&predicate)
+    -> std::size_t {
+  if constexpr (FlatRange<Range> &&
+                std::is_arithmetic_v<RangeElement<Range>>) {
+    constexpr std::size_t block = 64;
+    const auto *data = std::ranges::data(range);
+    auto size = static_cast<std::size_t>(std::ranges::size(range));
+    std::size_t i = 0;
+    for (; i + block <= size; i += block) {
+      // Bytes, as the vectorizer cannot reduce bools.
+      unsigned char passed[block];
+      for (std::size_t j = 0; j < block; ++j) {
+        passed[j] = predicate(data[i + j]) ? 1 : 0;
+      }
+      unsigned char all = 1;
+      for (std::size_t j = 0; j < block; ++j) {
+        all &= passed[j];
+      }
+      if (all == 0) {
+        auto *first = std::find(passed, passed + block, 0);
+        return i + static_cast<std::size_t>(first - passed);
+      }
+    }
+    for (; i < size; ++i) {
+      if (!predicate(data[i])) {
+        return i;
+      }
+    }
+    return noIndex;
+  } else {
+    std::size_t i = 0;
+    for (const auto &element : range) {
+      if (!predicate(element)) {
+        return i;
+      }
+      ++i;
+    }
+    return noIndex;
+  }
+}
+
+/**
+ * @brief `bound` as an element of type `T`, clamped to the values `T` can
+ * hold.
+ */
+template <typename T, typename Bound>
+constexpr auto clampBound(const Bound &bound) -> T {
+  if constexpr (std::is_integral_v<T> && std::is_integral_v<Bound>) {
+    using Limits = std::numeric_limits<T>;
+    if (std::cmp_less(bound, Limits::min())) {
+      return Limits::min();
+    }
+    if (std::cmp_greater(bound, Limits::max())) {
+      return Limits::max();
+    }
+  }
+  return static_cast<T>(bound);
+}
+
+/**
+ * @brief Whether `bound` converts to `T` without rounding, so that comparing
+ * it to elements of type `T` gives the same result after the conversion.
+ * Only a floating-point bound more precise than `T` may not; other bounds
+ * are converted to `T` by the comparison itself.
+ */
+template <typename T, typename Bound>
+auto exactBound(const Bound &bound) -> bool {
+  if constexpr (std::is_floating_point_v<Bound> &&
+                !std::is_same_v<std::common_type_t<T, Bound>, T>) {
+    if (std::isnan(bound) || std::isinf(bound)) {
+      return true;
+    }
+    return std::abs(bound) <= std::numeric_limits<T>::max() &&
+           static_cast<Bound>(static_cast<T>(bound)) == bound;
+  } else {
+    return true;
+  }
+}
+
+/**
+ * @brief Index of the first element outside of `[lo, hi]`, or noIndex.
+ */
+template <typename Range, typename Lo, typename Hi>
+auto findOutOfRange(const Range &range, const Lo &lo, const Hi &hi)
+    -> std::size_t {
+  if constexpr (KernelRange<Range> && std::is_arithmetic_v<Lo> &&
+                std::is_arithmetic_v<Hi> &&
+                (std::is_floating_point_v<RangeElement<Range>> ||
+                 (std::is_integral_v<Lo> && std::is_integral_v<Hi>))) {
+    using T = RangeElement<Range>;
+    if (exactBound<T>(lo) && exactBound<T>(hi)) {
+      auto size = static_cast<std::size_t>(std::ranges::size(range));
+      if constexpr (std::is_integral_v<T>) {
+        // A bound beyond what T can hold excludes every element.
+        using Limits = std::numeric_limits<T>;
+        if (std::cmp_greater(lo, Limits::max()) ||
+            std::cmp_less(hi, Limits::min())) {
+          return size == 0 ? noIndex : 0;
+        }
+      }
+      return firstOutOfRange(std::ranges::data(range), size,
+                             clampBound<T>(lo), clampBound<T>(hi));
+    }
+  }
+  return findFirstFailing(range, [&](const auto &element) {
+    return lessEqual(lo, element) && lessEqual(element, hi);
+  });
+}
+
+/**
+ * @brief Index of the first element that is less than the one before it,
+ * or noIndex.
+ */
+template <typename Range>
+auto findUnsorted(const Range &range) -> std::size_t {
+  if constexpr (KernelRange<Range>) {
+    return firstUnsorted(std::ranges::data(range),
+                         static_cast<std::size_t>(std::ranges::size(range)));
+  } else {
+    auto begin = std::ranges::begin(range);
+    auto end = std::ranges::end(range);
+    auto until = std::ranges::is_sorted_until(begin, end);
+    if (until == end) {
+      return noIndex;
+    }
+    return static_cast<std::size_t>(std::ranges::distance(begin, until));
+  }
+}
+
+/**
+ * @brief Index of the first NaN, or noIndex.
+ */
+template <typename Range>
+auto findNaN(const Range &range) -> std::size_t {
+  static_assert(std::is_floating_point_v<RangeElement<Range>>,
+                "only floating point ranges can contain NaN");
+  if constexpr (KernelRange<Range>) {
+    return firstNaN(std::ranges::data(range),
+                    static_cast<std::size_t>(std::ranges::size(range)));
+  } else {
+    return findFirstFailing(
+        range, [](const auto &element) { return element == element; });
+  }
+}
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_RANGES_HPP
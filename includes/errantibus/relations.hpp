@@ -0,0 +1,26 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_RELATIONS_HPP
+#define ERRANTIBUS_RELATIONS_HPP
+
+namespace errantibus::internal {
+
+/**
+ * @brief Whether `a` and `b` differ by at most `tolerance`. NaN is never
+ * near anything, and equal infinities are near each other.
+ */
+template <typename A, typename B, typename Tolerance>
+constexpr auto isNear(const A &a, const B &b, const Tolerance &tolerance)
+    -> bool {
+  if (a == b) {
+    return true;
+  }
+  return (a < b ? b - a : a - b) <= tolerance;
+}
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_RELATIONS_HPP
@@ -0,0 +1,102 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_SAMPLED_HPP
+#define ERRANTIBUS_SAMPLED_HPP
+
+#include <time.h>
+
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+
+namespace errantibus::internal {
+
+/// The interval of an assertSampled that is never checked.
+constexpr auto neverSampled = std::numeric_limits<std::uint32_t>::max();
+
+/**
+ * @brief Executions between two checks of an assertSampled. `rate` is either
+ * a count, checking one in `rate` executions, or a fraction like `0.01`. A
+ * rate of zero or below never checks, whether it is written as `0.0` or as
+ * an integer, like `1 / 1000`.
+ */
+template <typename Rate>
+constexpr auto samplingInterval(Rate rate) -> std::uint32_t {
+  if constexpr (std::floating_point<Rate>) {
+    if (!(rate > 0)) {
+      return neverSampled;
+    }
+    if (rate >= 1) {
+      return 1;
+    }
+    auto interval = 1 / rate + Rate(0.5);
+    return interval >= Rate(neverSampled)
+               ? neverSampled - 1
+               : static_cast<std::uint32_t>(interval);
+  } else {
+    if (rate < 1) {
+      return neverSampled;
+    }
+    return static_cast<std::uintmax_t>(rate) >= neverSampled
+               ? neverSampled - 1
+               : static_cast<std::uint32_t>(rate);
+  }
+}
+
+/**
+ * @brief A monotonic clock in nanoseconds that is cheap to read. Its
+ * resolution of a few milliseconds is plenty for rate limiting.
+ */
+inline auto coarseNanoseconds() -> std::int64_t {
+#ifdef CLOCK_MONOTONIC_COARSE
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+  return static_cast<std::int64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+template <typename Rep, typename Period>
+constexpr auto windowNanoseconds(std::chrono::duration<Rep, Period> window)
+    -> std::int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(window).count();
+}
+
+} // namespace errantibus::internal
+
+/*
+ * Both macros keep their state per call site and per thread, so the fast
+ * path is a thread-local decrement or clock read without shared writes.
+ * When they do check, they behave exactly like assertAlways.
+ */
+
+#define assertSampled(cond, rate, msg, ...)                                    \
+  do {                                                                         \
+    static thread_local std::uint32_t assertCountdown = 1;                     \
+    if (--assertCountdown == 0) [[unlikely]] {                                 \
+      assertCountdown = errantibus::internal::samplingInterval(rate);          \
+      if (assertCountdown != errantibus::internal::neverSampled) {             \
+        assertAlways(cond, msg, __VA_ARGS__);                                  \
+      }                                                                        \
+    }                                                                          \
+  } while (false)
+
+#define assertEvery(cond, window, msg, ...)                                    \
+  do {                                                                         \
+    static thread_local std::int64_t assertDeadline = 0;                       \
+    auto assertNow = errantibus::internal::coarseNanoseconds();                \
+    if (assertNow >= assertDeadline) [[unlikely]] {                            \
+      assertDeadline =                                                         \
+          assertNow + errantibus::internal::windowNanoseconds(window);         \
+      assertAlways(cond, msg, __VA_ARGS__);                                    \
+    }                                                                          \
+  } while (false)
+
+#endif // !ERRANTIBUS_SAMPLED_HPP
@@ -0,0 +1,24 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_SIGNAL_HANDLERS_HPP
+#define ERRANTIBUS_SIGNAL_HANDLERS_HPP
+
+namespace errantibus {
+
+/**
+ * @brief Report SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT like a failed
+ * assertion, with the signal and the raw stack trace, before handing the
+ * signal on to the handler that was installed before.
+ *
+ * The report is written without allocating, so it also comes out after
+ * heap corruption. A stack overflow can only be reported on the thread that
+ * called this function, as only that thread gets an alternate signal stack.
+ */
+void installSignalHandlers();
+
+} // namespace errantibus
+
+#endif // !ERRANTIBUS_SIGNAL_HANDLERS_HPP
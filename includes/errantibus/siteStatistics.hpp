@@ -0,0 +1,174 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_SITE_STATISTICS_HPP
+#define ERRANTIBUS_SITE_STATISTICS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace errantibus {
+
+/**
+ * @brief What is known about one assertion in the program. Only assertions
+ * compiled with `ERRANTIBUS_SITE_STATISTICS` defined are listed.
+ */
+struct SiteStatistics {
+  const char *kind;
+  const char *file;
+  std::uint32_t line;
+  const char *condition;
+  std::uint64_t evaluations;
+  std::uint64_t samples;
+  std::uint64_t sampledCycles;
+};
+
+/**
+ * @brief Every assertion compiled into the program, with its counters
+ * summed over all threads.
+ */
+auto siteStatistics() -> std::vector<SiteStatistics>;
+
+/**
+ * @brief Write a table of all assertions, most expensive first.
+ */
+void dumpSiteStatistics(std::ostream &out);
+
+/**
+ * @brief Measure the cycles of every `interval`-th evaluation of each
+ * thread. Zero, the default, measures nothing.
+ */
+void setCycleSampling(std::uint32_t interval);
+
+} // namespace errantibus
+
+namespace errantibus::internal {
+
+/**
+ * @brief Static description of one assertion. `index` is its slot in the
+ * counters, assigned when the registry is built; sites the registry does
+ * not know of share slot zero.
+ */
+struct CallSite {
+  const char *kind;
+  const char *file;
+  const char *condition;
+  std::uint32_t line;
+  std::uint32_t index = 0;
+};
+
+struct SiteCounter {
+  std::atomic<std::uint64_t> evaluations = 0;
+  std::atomic<std::uint64_t> samples = 0;
+  std::atomic<std::uint64_t> sampledCycles = 0;
+};
+
+/// The calling thread's counters, one per site; null until first used.
+inline thread_local SiteCounter *localSiteCounters = nullptr;
+inline thread_local std::uint32_t sampleCountdown = 0;
+
+auto attachSiteCounters() -> SiteCounter *;
+auto startSample() -> std::uint64_t;
+void recordSample(const CallSite &site, std::uint64_t start);
+
+inline auto cycleCount() -> std::uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct SiteProbe {
+  const CallSite *site = nullptr;
+  std::uint64_t start = 0;
+};
+
+/**
+ * @brief Count an evaluation of `site`, and start measuring it if this
+ * evaluation is sampled.
+ */
+inline auto beginEvaluation([[maybe_unused]] const CallSite &site)
+    -> SiteProbe {
+#ifdef ERRANTIBUS_SITE_STATISTICS
+  auto *counters = localSiteCounters;
+  if (counters == nullptr) [[unlikely]] {
+    counters = attachSiteCounters();
+  }
+  // Only this thread writes its counters, so no atomic increment is needed.
+  auto &evaluations = counters[site.index].evaluations;
+  evaluations.store(evaluations.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+  if (--sampleCountdown == 0) [[unlikely]] {
+    return {&site, startSample()};
+  }
+#endif
+  return {};
+}
+
+inline void endEvaluation([[maybe_unused]] const SiteProbe &probe) {
+#ifdef ERRANTIBUS_SITE_STATISTICS
+  if (probe.start != 0) [[unlikely]] {
+    recordSample(*probe.site, probe.start);
+  }
+#endif
+}
+
+} // namespace errantibus::internal
+
+/*
+ * Every call site puts a pointer to its descriptor into the
+ * `errantibus_sites` section, so the linker builds the list of all of them
+ * and nothing is registered at runtime. This is done in assembly because
+ * GCC refuses to mix the section attribute on static variables of inline
+ * and non-inline functions. The entry joins the section group of the
+ * enclosing function (`?`), so it is dropped together with a discarded
+ * inline copy. Shared objects cannot refer to these variables this way, so
+ * their sites are only counted, under slot zero.
+ */
+#if defined(__PIC__) && !defined(__PIE__)
+#define ERRANTIBUS_REGISTER_SITE(site) static_cast<void>(site)
+#else
+#define ERRANTIBUS_REGISTER_SITE(site)                                         \
+  asm(".pushsection errantibus_sites,\"aw?\"\n"                                \
+      ".balign 8\n"                                                            \
+      ".dc.a %c0\n"                                                            \
+      ".popsection"                                                            \
+      :                                                                        \
+      : "i"(&(site)))
+#endif
+
+/**
+ * @brief Declare the call site of an assertion and start an evaluation of
+ * it. Nothing happens during constant evaluation. Without
+ * `ERRANTIBUS_SITE_STATISTICS`, the site is neither declared nor
+ * registered, so the assertion costs no data and no section entry.
+ */
+#ifdef ERRANTIBUS_SITE_STATISTICS
+#define ERRANTIBUS_BEGIN_SITE(probe, kind, condition)                          \
+  errantibus::internal::SiteProbe probe;                                       \
+  if !consteval {                                                              \
+    static constinit errantibus::internal::CallSite probe##Site{               \
+        kind, __FILE__, condition, __LINE__};                                  \
+    ERRANTIBUS_REGISTER_SITE(probe##Site);                                     \
+    probe = errantibus::internal::beginEvaluation(probe##Site);                \
+  }
+#else
+#define ERRANTIBUS_BEGIN_SITE(probe, kind, condition)                          \
+  errantibus::internal::SiteProbe probe
+#endif
+
+#define ERRANTIBUS_END_SITE(probe) errantibus::internal::endEvaluation(probe)
+
+#endif // !ERRANTIBUS_SITE_STATISTICS_HPP
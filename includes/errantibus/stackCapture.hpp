@@ -0,0 +1,79 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_STACK_CAPTURE_HPP
+#define ERRANTIBUS_STACK_CAPTURE_HPP
+
+#include "errantibus/format.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+
+namespace errantibus {
+
+/**
+ * @brief Write the return addresses of the calling thread's stack to
+ * `frames`, innermost first, and return how many were written. The first
+ * one is in the caller, unless `skip` frames above it are left out.
+ *
+ * This walks the frame pointers if Errantibus was built with
+ * `ERRANTIBUS_FRAME_POINTERS`, and uses the unwinder otherwise. Nothing is
+ * symbolized, which is left to printStack.
+ */
+[[gnu::noinline]] auto captureStack(std::span<const void *> frames,
+                                    std::size_t skip = 0) -> std::size_t;
+
+/**
+ * @brief Print captured frames with their symbols and source locations,
+ * outermost first, like the stack trace of a failing assertion.
+ */
+void printStack(std::ostream &out, std::span<const void *const> frames);
+
+/**
+ * @brief A short stack trace, captured by value. It is trivially copyable,
+ * so `debug(...)` in async mode and `errantibusRecord(...)` store it as raw
+ * bytes, and its frames are only symbolized when the message is printed.
+ */
+class Backtrace {
+public:
+  static constexpr std::size_t capacity = 16;
+
+  auto frames() const -> std::span<const void *const> {
+    return std::span(addresses.data(), size);
+  }
+
+private:
+  friend auto captureBacktrace(std::size_t skip) -> Backtrace;
+
+  std::array<const void *, capacity> addresses{};
+  std::uint32_t size = 0;
+};
+
+/**
+ * @brief Capture the innermost frames of the calling thread's stack, see
+ * captureStack.
+ */
+[[gnu::noinline]] auto captureBacktrace(std::size_t skip = 0) -> Backtrace;
+
+/// Formats the frames of a backtrace, one per line.
+void errantibusFormat(Writer &out, const Backtrace &trace);
+
+} // namespace errantibus
+
+namespace errantibus::internal {
+
+/**
+ * @brief Like captureStack, but always with the unwinder, which also gets
+ * through code built without frame pointers, like the C runtime.
+ */
+[[gnu::noinline]] auto unwindStack(std::span<const void *> frames,
+                                   std::size_t skip = 0) -> std::size_t;
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_STACK_CAPTURE_HPP
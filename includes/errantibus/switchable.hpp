@@ -0,0 +1,82 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_SWITCHABLE_HPP
+#define ERRANTIBUS_SWITCHABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+namespace errantibus {
+
+/**
+ * @brief Turn on the `assertSwitchable` sites matched by `selectors`, a comma
+ * separated list of
+ *
+ *  - `all`: every site,
+ *  - `tag:<name>`: sites with that tag,
+ *  - `file:<path>`: sites in a file whose path ends with `<path>`.
+ *
+ * A selector prefixed with `-` turns its sites off instead. When selectors
+ * overlap, the last one wins. The environment variable
+ * `ERRANTIBUS_ASSERTIONS` is read with the same syntax at startup.
+ */
+void enableAssertions(std::string_view selectors);
+
+/**
+ * @brief Turn off the `assertSwitchable` sites matched by `selectors`.
+ */
+void disableAssertions(std::string_view selectors);
+
+/**
+ * @brief Forget all selectors, turning every `assertSwitchable` off.
+ */
+void resetAssertions();
+
+} // namespace errantibus
+
+namespace errantibus::internal {
+
+enum class SwitchState : std::uint8_t { unresolved, off, on };
+
+/**
+ * @brief Per call site state of an `assertSwitchable`. Sites are resolved
+ * against the selectors the first time they run and updated whenever the
+ * selectors change, so the check itself is a single load.
+ */
+struct SwitchSite {
+  const char *file;
+  const char *tag;
+  std::atomic<SwitchState> state = SwitchState::unresolved;
+  SwitchSite *next = nullptr;
+};
+
+auto resolveSwitch(SwitchSite &site) -> bool;
+
+inline auto switchEnabled(SwitchSite &site) -> bool {
+  auto state = site.state.load(std::memory_order_relaxed);
+  if (state == SwitchState::off) [[likely]] {
+    return false;
+  }
+  return state == SwitchState::on || resolveSwitch(site);
+}
+
+} // namespace errantibus::internal
+
+/*
+ * Like assertAlways, but only checked while switched on at runtime. While
+ * off, it costs one load and a well-predicted branch.
+ */
+#define assertSwitchable(tag, cond, msg, ...)                                  \
+  do {                                                                         \
+    static constinit errantibus::internal::SwitchSite assertSwitch{__FILE__,   \
+                                                                   tag};       \
+    if (errantibus::internal::switchEnabled(assertSwitch)) [[unlikely]] {      \
+      assertAlways(cond, msg, __VA_ARGS__);                                    \
+    }                                                                          \
+  } while (false)
+
+#endif // !ERRANTIBUS_SWITCHABLE_HPP
@@ -3,162 +3,1016 @@
  * See <https://github.com/jakobteuber/errantibus>
  */
 
-#ifndef ERRANTIBUS_DEFINITIONS_HPP
-#define ERRANTIBUS_DEFINITIONS_HPP
+#ifndef ERRANTIBUS_DEBUG_DEFINITIONS_HPP
+#define ERRANTIBUS_DEBUG_DEFINITIONS_HPP
 
+#include "errantibus/asyncAssert.hpp"
+#include "errantibus/asyncDebug.hpp"
+#include "errantibus/checks.hpp"
+#include "errantibus/expressions.hpp"
+#include "errantibus/flightRecorder.hpp"
+#include "errantibus/format.hpp"
+#include "errantibus/output.hpp"
+#include "errantibus/ranges.hpp"
+#include "errantibus/relations.hpp"
+#include "errantibus/sampled.hpp"
+#include "errantibus/switchable.hpp"
+#include "errantibus/siteStatistics.hpp"
+#include "errantibus/stackCapture.hpp"
+
+#include <array>
+#include <concepts>
 #include <cstddef>
-#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <ostream>
+#include <ranges>
+#include <span>
+#include <streambuf>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace errantibus::internal {
 
+template <typename T>
+concept CustomFormattable = requires(Writer &out, const T &obj) {
+  errantibusFormat(out, obj);
+};
+
+template <typename T>
+concept Number =
+    (std::integral<T> || std::floating_point<T>) && !CustomFormattable<T>;
+
+template <typename T>
+concept StringLike = std::is_convertible_v<const T &, std::string_view> &&
+                     !CustomFormattable<T>;
+
 template <typename T>
 concept StreamPrintable =
-    requires(T obj, std::ostringstream &out) { out << obj; };
+    requires(std::ostream &out, const T &obj) { out << obj; } &&
+    !CustomFormattable<T> && !Number<T> && !StringLike<T>;
 
 template <typename T>
-concept Iterable = requires(T iterable) {
+concept Iterable = requires(const T &iterable) {
   std::cbegin(iterable);
   std::cend(iterable);
-} && !StreamPrintable<T>;
+} && !CustomFormattable<T> && !StringLike<T> && !StreamPrintable<T>;
 
-void stringify(std::ostringstream &out, const auto &obj);
+void stringify(Writer &out, const auto &obj);
 
-void stringify(std::ostringstream &out, char obj);
-void stringify(std::ostringstream &out, unsigned char obj);
-void stringify(std::ostringstream &out, signed char obj);
-void stringify(std::ostringstream &out, bool obj);
+void stringify(Writer &out, char obj);
+void stringify(Writer &out, unsigned char obj);
+void stringify(Writer &out, signed char obj);
+void stringify(Writer &out, bool obj);
+
+template <CustomFormattable T>
+inline void stringify(Writer &out, const T &obj) {
+  errantibusFormat(out, obj);
+}
+
+template <Number T>
+inline void stringify(Writer &out, const T &obj) {
+  out.append('`');
+  out.appendNumber(obj);
+  out.append('`');
+}
+
+template <StringLike T>
+inline void stringify(Writer &out, const T &obj) {
+  if constexpr (std::is_pointer_v<T>) {
+    if (obj == nullptr) {
+      out.append("`nullptr`");
+      return;
+    }
+  }
+  out.append('`');
+  out.append(std::string_view(obj));
+  out.append('`');
+}
+
+/**
+ * @brief Lets `operator<<` of types without a faster path write straight
+ * into the report instead of into a temporary string.
+ */
+class WriterStreambuf : public std::streambuf {
+public:
+  explicit WriterStreambuf(Writer &out) : out(out) {}
+
+protected:
+  auto overflow(int_type c) -> int_type override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      out.append(traits_type::to_char_type(c));
+    }
+    return out.exhausted() ? traits_type::eof() : traits_type::not_eof(c);
+  }
+
+  auto xsputn(const char *text, std::streamsize count)
+      -> std::streamsize override {
+    out.append(std::string_view(text, static_cast<std::size_t>(count)));
+    // Reporting a short write makes the stream stop at the byte limit.
+    return out.exhausted() ? 0 : count;
+  }
+
+private:
+  Writer &out;
+};
 
 template <StreamPrintable T>
-inline void stringify(std::ostringstream &out, const T &obj) {
-  out << '`' << obj << "`";
+inline void stringify(Writer &out, const T &obj) {
+  out.append('`');
+  auto buffer = WriterStreambuf(out);
+  auto stream = std::ostream(&buffer);
+  stream << obj;
+  out.append('`');
 }
 
 template <Iterable T>
-inline void stringify(std::ostringstream &out, const T &obj) {
-  auto contents = std::ostringstream();
-  bool first = true;
-  for (const auto &x : obj) {
+void stringify(Writer &out, const T &obj);
+
+template <typename Iterator>
+inline void writeElements(Writer &out, Iterator it, std::size_t count,
+                          bool &first) {
+  for (std::size_t i = 0; i < count && !out.exhausted(); ++i, ++it) {
     if (first) {
       first = false;
     } else {
-      contents << ", ";
+      out.append(", ");
     }
-    stringify(contents, x);
+    stringify(out, *it);
   }
-  out << '{' << contents.str() << '}';
 }
 
-inline void stringify(std::ostringstream &out,
-                      [[maybe_unused]] const auto &obj) {
-  out << "not printable\n";
+/**
+ * @brief The rest of a container of `size` elements that is too long to be
+ * shown in full, after its opening brace: `headCount` elements from `head`,
+ * an ellipsis, `tailCount` elements from `tail`, and the size.
+ */
+template <typename Iterator>
+inline void writeElided(Writer &out, Iterator head, std::size_t headCount,
+                        Iterator tail, std::size_t tailCount,
+                        std::size_t size) {
+  bool first = true;
+  writeElements(out, head, headCount, first);
+  out.append(first ? "..." : ", ...");
+  first = false;
+  writeElements(out, tail, tailCount, first);
+  out.append("} (size ");
+  out.appendNumber(size);
+  out.append(')');
 }
 
-inline auto toString(const auto &obj) -> std::string {
-  auto out = std::ostringstream();
+/**
+ * @brief Containers show at most FormatLimits::maxElements elements. Of a
+ * longer one that knows its size, the first and last few elements are shown
+ * together with the size; otherwise the output stops after the first few.
+ */
+template <Iterable T>
+void stringify(Writer &out, const T &obj) {
+  if (!out.enter()) {
+    out.append("{...}");
+    return;
+  }
+  out.append('{');
+  bool first = true;
+  std::size_t limit = out.limits().maxElements;
+  if constexpr (std::ranges::sized_range<const T> &&
+                std::ranges::bidirectional_range<const T> &&
+                std::ranges::common_range<const T>) {
+    auto size = static_cast<std::size_t>(std::ranges::size(obj));
+    if (size <= limit) {
+      writeElements(out, std::ranges::begin(obj), size, first);
+    } else {
+      std::size_t tail = limit / 2;
+      writeElided(out, std::ranges::begin(obj), limit - tail,
+                  std::ranges::prev(std::ranges::end(obj),
+                                    static_cast<std::ptrdiff_t>(tail)),
+                  tail, size);
+      out.leave();
+      return;
+    }
+  } else {
+    auto it = std::cbegin(obj);
+    auto end = std::cend(obj);
+    for (std::size_t i = 0; it != end && !out.exhausted(); ++i, ++it) {
+      if (i == limit) {
+        out.append(first ? "..." : ", ...");
+        break;
+      }
+      writeElements(out, it, 1, first);
+    }
+  }
+  out.append('}');
+  out.leave();
+}
+
+inline void stringify(Writer &out, [[maybe_unused]] const auto &obj) {
+  out.append("not printable\n");
+}
+
+inline auto formatInto(Arena &arena, const auto &obj) -> std::string_view {
+  arena.beginValue();
+  auto out = Writer(arena);
   stringify(out, obj);
-  return out.str();
+  out.finish();
+  return arena.endValue();
 }
 
-inline void report([[maybe_unused]] const std::vector<std::string> &strings) {}
+/**
+ * @brief A single value formatted into the thread's arena. The memory goes
+ * back to the arena when the value is destroyed, which for the temporaries
+ * in the assertion macros is the end of the report.
+ */
+class Formatted {
+public:
+  explicit Formatted(const auto &obj) :
+      arena(Arena::local()), mark(arena.mark()), text(formatInto(arena, obj)) {}
+  Formatted(const Formatted &) = delete;
+  Formatted(Formatted &&) = delete;
+  auto operator=(const Formatted &) -> Formatted & = delete;
+  auto operator=(Formatted &&) -> Formatted & = delete;
+  ~Formatted() { arena.release(mark); }
+
+  auto view() const -> std::string_view { return text; }
+  operator std::string_view() const { return text; } // NOLINT
+
+private:
+  Arena &arena;
+  Arena::Mark mark;
+  std::string_view text;
+};
+
+inline auto formatValue(const auto &obj) -> Formatted { return Formatted(obj); }
+
+/**
+ * @brief All extra arguments of a macro, formatted back to back into the
+ * thread's arena.
+ */
+template <std::size_t N>
+class Report {
+public:
+  template <typename... Args>
+  explicit Report(const Args &...args) :
+      arena(Arena::local()), mark(arena.mark()) {
+    [[maybe_unused]] std::size_t i = 0;
+    ((values[i++] = formatInto(arena, args)), ...);
+  }
+  Report(const Report &) = delete;
+  Report(Report &&) = delete;
+  auto operator=(const Report &) -> Report & = delete;
+  auto operator=(Report &&) -> Report & = delete;
+  ~Report() { arena.release(mark); }
+
+  operator std::span<const std::string_view>() const { // NOLINT
+    return values;
+  }
+
+private:
+  Arena &arena;
+  Arena::Mark mark;
+  std::array<std::string_view, N> values;
+};
 
 template <typename... Args>
-void report(std::vector<std::string> &strings, auto first, Args... arguments) {
-  strings.push_back(toString(first));
-  report(strings, arguments...);
+auto generateReport(const Args &...args) -> Report<sizeof...(Args)> {
+  return Report<sizeof...(Args)>(args...);
+}
+
+/**
+ * @brief The elements around `index` of a range, formatted into the thread's
+ * arena like a Report.
+ */
+class RangeWindow {
+public:
+  static constexpr std::size_t radius = 3;
+
+  template <typename Range>
+  RangeWindow(const Range &range, std::size_t index) :
+      arena(Arena::local()), mark(arena.mark()),
+      size(static_cast<std::size_t>(std::ranges::distance(range))),
+      index(index), first(index < radius ? 0 : index - radius) {
+    auto it = std::ranges::begin(range);
+    auto end = std::ranges::end(range);
+    std::ranges::advance(it, static_cast<std::ptrdiff_t>(first), end);
+    for (; it != end && count < values.size(); ++it) {
+      values[count++] = formatInto(arena, *it);
+    }
+  }
+  RangeWindow(const RangeWindow &) = delete;
+  RangeWindow(RangeWindow &&) = delete;
+  auto operator=(const RangeWindow &) -> RangeWindow & = delete;
+  auto operator=(RangeWindow &&) -> RangeWindow & = delete;
+  ~RangeWindow() { arena.release(mark); }
+
+  operator RangeExcerpt() const { // NOLINT
+    return {size, index, first, std::span(values.data(), count)};
+  }
+
+private:
+  Arena &arena;
+  Arena::Mark mark;
+  std::size_t size;
+  std::size_t index;
+  std::size_t first;
+  std::size_t count = 0;
+  std::array<std::string_view, 2 * radius + 1> values;
+};
+
+/**
+ * @brief Types whose bytes are their whole value. A Backtrace only points
+ * into code, which stays where it is. Other trivially copyable types, like
+ * views and pointers, may refer to memory that is gone by the time the
+ * record is decoded, so they are formatted right away.
+ */
+template <typename T>
+concept RawEncodable = std::is_arithmetic_v<T> || std::is_enum_v<T> ||
+                       std::same_as<T, Backtrace>;
+
+template <typename T>
+concept ContiguousEncodable =
+    std::ranges::contiguous_range<const T> &&
+    std::ranges::sized_range<const T> &&
+    RawEncodable<std::ranges::range_value_t<const T>> && !StringLike<T>;
+
+/**
+ * @brief The bytes `debug(...)` stores for an argument in async mode, and
+ * how to turn them back into text. Types without a raw representation are
+ * formatted right away.
+ */
+template <typename T>
+struct Encoded {
+  Formatted text;
+
+  explicit Encoded(const T &obj) : text(obj) {}
+  auto size() const -> std::size_t { return text.view().size(); }
+  void write(std::byte *out) const {
+    std::memcpy(out, text.view().data(), size());
+  }
+  auto decoder() const -> Decoder { return &decode; }
+
+  static void decode(Writer &out, const std::byte *data, std::size_t size) {
+    out.append(std::string_view(reinterpret_cast<const char *>(data), size));
+  }
+};
+
+template <StringLike T>
+struct Encoded<T> {
+  std::string_view text;
+
+  bool null = false;
+
+  // Anything past the byte limit would be cut off when decoding anyway.
+  explicit Encoded(const T &obj) {
+    if constexpr (std::is_pointer_v<T>) {
+      if (obj == nullptr) {
+        null = true;
+        return;
+      }
+    }
+    text = std::string_view(obj).substr(0, formatLimits().maxValueBytes);
+  }
+  auto size() const -> std::size_t { return text.size(); }
+  void write(std::byte *out) const {
+    std::memcpy(out, text.data(), text.size());
+  }
+  /// A null pointer has no bytes to tell it from an empty string, so it
+  /// gets a decoder of its own.
+  auto decoder() const -> Decoder { return null ? &decodeNull : &decode; }
+
+  static void decode(Writer &out, const std::byte *data, std::size_t size) {
+    stringify(out,
+              std::string_view(reinterpret_cast<const char *>(data), size));
+  }
+
+  static void decodeNull(Writer &out, [[maybe_unused]] const std::byte *data,
+                         [[maybe_unused]] std::size_t size) {
+    out.append("`nullptr`");
+  }
+};
+
+template <RawEncodable T>
+struct Encoded<T> {
+  const T &obj;
+
+  explicit Encoded(const T &obj) : obj(obj) {}
+  auto decoder() const -> Decoder { return &decode; }
+  auto size() const -> std::size_t { return sizeof(T); }
+  void write(std::byte *out) const { std::memcpy(out, &obj, sizeof(T)); }
+
+  static void decode(Writer &out, const std::byte *data,
+                     [[maybe_unused]] std::size_t size) {
+    alignas(T) std::byte storage[sizeof(T)];
+    std::memcpy(storage, data, sizeof(T));
+    stringify(out, *std::launder(reinterpret_cast<const T *>(storage)));
+  }
+};
+
+/**
+ * @brief A contiguous range is stored as its length and the elements a
+ * report would show: all of them, or if there are more than
+ * FormatLimits::maxElements, the first and last few.
+ */
+template <ContiguousEncodable T>
+struct Encoded<T> {
+  using Value = std::ranges::range_value_t<const T>;
+
+  /// The length of the range, and how many of the stored elements are from
+  /// its start. The others are from its end.
+  struct Lengths {
+    std::uint64_t total;
+    std::uint64_t head;
+  };
+
+  const T &obj;
+  Lengths lengths{};
+  std::size_t tail = 0;
+
+  explicit Encoded(const T &obj) : obj(obj) {
+    auto total = static_cast<std::size_t>(std::ranges::size(obj));
+    auto limit = formatLimits().maxElements;
+    if (total > limit) {
+      tail = limit / 2;
+    }
+    lengths = {total, std::min(total, limit) - tail};
+  }
+  auto decoder() const -> Decoder { return &decode; }
+  auto size() const -> std::size_t {
+    return sizeof(Lengths) + (lengths.head + tail) * sizeof(Value);
+  }
+  void write(std::byte *out) const {
+    const Value *data = std::ranges::data(obj);
+    std::memcpy(out, &lengths, sizeof(Lengths));
+    out += sizeof(Lengths);
+    std::memcpy(out, data, lengths.head * sizeof(Value));
+    std::memcpy(out + lengths.head * sizeof(Value),
+                data + (lengths.total - tail), tail * sizeof(Value));
+  }
+
+  static void decode(Writer &out, const std::byte *data, std::size_t size) {
+    auto lengths = Lengths();
+    std::memcpy(&lengths, data, sizeof(Lengths));
+    auto values = std::vector<Value>((size - sizeof(Lengths)) / sizeof(Value));
+    std::memcpy(values.data(), data + sizeof(Lengths),
+                values.size() * sizeof(Value));
+    if (lengths.total == values.size()) {
+      stringify(out, values);
+      return;
+    }
+    if (!out.enter()) {
+      out.append("{...}");
+      return;
+    }
+    out.append('{');
+    auto tail = values.begin() + static_cast<std::ptrdiff_t>(lengths.head);
+    writeElided(out, values.begin(), lengths.head, tail,
+                values.size() - lengths.head, lengths.total);
+    out.leave();
+  }
+};
+
+template <typename T>
+void writeArgument(std::byte *&cursor, const Encoded<T> &encoded) {
+  auto size = encoded.size();
+  auto header = ArgumentHeader{encoded.decoder(), size};
+  std::memcpy(cursor, &header, sizeof(header));
+  encoded.write(cursor + sizeof(header));
+  cursor += sizeof(header) + alignRecord(size);
 }
 
 template <typename... Args>
-auto generateReport(Args... args) -> std::vector<std::string> {
-  auto strings = std::vector<std::string>();
-  strings.reserve(sizeof...(args));
-  report(strings, args...);
-  return strings;
+void enqueueDebug(const DebugSite &site, const Args &...args) {
+  const std::tuple<Encoded<Args>...> encoded(args...);
+  std::size_t size = sizeof(RecordHeader);
+  std::apply(
+      [&](const auto &...e) {
+        ((size += sizeof(ArgumentHeader) + alignRecord(e.size())), ...);
+      },
+      encoded);
+  std::byte *record = reserveDebugRecord(size);
+  if (record == nullptr) {
+    return;
+  }
+  auto header = RecordHeader{&site, static_cast<std::uint32_t>(size),
+                             static_cast<std::uint32_t>(sizeof...(Args))};
+  std::memcpy(record, &header, sizeof(header));
+  std::byte *cursor = record + sizeof(header);
+  std::apply([&](const auto &...e) { (writeArgument(cursor, e), ...); },
+             encoded);
+  commitDebugRecord(size);
+}
+
+template <typename T>
+void writeFlightArgument(std::byte *&cursor, std::size_t &budget,
+                         const Encoded<T> &encoded) {
+  auto size = encoded.size();
+  auto payload = alignRecord(size);
+  auto header = ArgumentHeader{encoded.decoder(), size};
+  if (payload > budget) {
+    header = ArgumentHeader{&decodeOversized, 0};
+    payload = 0;
+  } else {
+    encoded.write(cursor + sizeof(header));
+    budget -= payload;
+  }
+  std::memcpy(cursor, &header, sizeof(header));
+  cursor += sizeof(header) + payload;
+}
+
+/**
+ * @brief Store an event in the calling thread's flight recorder. Apart from
+ * creating the ring on a thread's first event, this only copies bytes.
+ */
+template <typename... Args>
+void recordEvent(const DebugSite &site, const Args &...args) {
+  static_assert(sizeof...(Args) <= maxFlightArguments,
+                "too many arguments for a single errantibusRecord(...)");
+  FlightRing *ring = localFlightRing;
+  if (ring == nullptr) [[unlikely]] {
+    ring = attachFlightRing();
+    if (ring == nullptr) {
+      return;
+    }
+  }
+  const std::tuple<Encoded<Args>...> encoded(args...);
+  auto index = ring->next++;
+  auto &slot = ring->slots[index & ring->mask];
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::size_t budget = sizeof(slot.record) - sizeof(RecordHeader) -
+                       sizeof...(Args) * sizeof(ArgumentHeader);
+  std::byte *cursor = slot.record + sizeof(RecordHeader);
+  std::apply(
+      [&](const auto &...e) { (writeFlightArgument(cursor, budget, e), ...); },
+      encoded);
+  auto header =
+      RecordHeader{&site, static_cast<std::uint32_t>(cursor - slot.record),
+                   static_cast<std::uint32_t>(sizeof...(Args))};
+  std::memcpy(slot.record, &header, sizeof(header));
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
 }
 
 void printDebug(std::string_view file, std::size_t line,
-                std::string_view expressions,
-                const std::vector<std::string> &values);
+                std::span<const std::string_view> expressions,
+                std::span<const std::string_view> values);
 [[noreturn]] void fail(std::string_view message, std::string_view file,
-                       std::size_t line, std::string_view expressions,
-                       const std::vector<std::string> &values);
+                       std::size_t line,
+                       std::span<const std::string_view> expressions,
+                       std::span<const std::string_view> values);
 [[noreturn]] void failAssert(std::string_view message,
                              std::string_view condition, std::string_view file,
-                             std::size_t line, std::string_view expressions,
-                             const std::vector<std::string> &values);
-[[noreturn]] void failEq(std::string_view message, std::string_view firstExpr,
-                         std::string_view firstValue,
-                         std::string_view secondExpr,
-                         std::string_view secondValue, std::string_view file,
-                         std::size_t line, std::string_view expressions,
-                         const std::vector<std::string> &values);
-[[noreturn]] void failNeq(std::string_view message, std::string_view firstExpr,
-                          std::string_view firstValue,
-                          std::string_view secondExpr,
-                          std::string_view secondValue, std::string_view file,
-                          std::size_t line, std::string_view expressions,
-                          const std::vector<std::string> &values);
+                             std::size_t line,
+                             std::span<const std::string_view> expressions,
+                             std::span<const std::string_view> values);
+[[noreturn]] void failCompare(std::string_view message,
+                              std::string_view expectation,
+                              std::string_view firstExpr,
+                              std::string_view firstValue,
+                              std::string_view secondExpr,
+                              std::string_view secondValue,
+                              std::string_view file, std::size_t line,
+                              std::span<const std::string_view> expressions,
+                              std::span<const std::string_view> values);
+[[noreturn]] void failNear(std::string_view message, std::string_view firstExpr,
+                           std::string_view firstValue,
+                           std::string_view secondExpr,
+                           std::string_view secondValue,
+                           std::string_view toleranceExpr,
+                           std::string_view toleranceValue,
+                           std::string_view file, std::size_t line,
+                           std::span<const std::string_view> expressions,
+                           std::span<const std::string_view> values);
+[[noreturn]] void failRange(std::string_view message,
+                            std::string_view expectation,
+                            std::string_view rangeExpr, RangeExcerpt excerpt,
+                            std::string_view file, std::size_t line,
+                            std::span<const std::string_view> expressions,
+                            std::span<const std::string_view> values);
+
+/**
+ * @brief Like failAssert, for an `assertAsync` whose predicate failed. If it
+ * was verified by the pool, `origin` is where the assertion was made.
+ */
+[[noreturn]] void failAsync(std::string_view message,
+                            std::string_view condition, std::string_view file,
+                            std::size_t line, const AsyncOrigin *origin,
+                            std::span<const std::string_view> expressions,
+                            std::span<const std::string_view> values);
+
+/*
+ * The failure reports of the `check*` macros, which are passed to the check
+ * handler instead of terminating. `number` counts the failures of `site`.
+ */
+void reportCheckAssert(CheckSite &site, std::uint64_t number,
+                       std::string_view message, std::string_view condition,
+                       std::string_view file, std::size_t line,
+                       std::span<const std::string_view> expressions,
+                       std::span<const std::string_view> values);
+void reportCheckCompare(CheckSite &site, std::uint64_t number,
+                        std::string_view message, std::string_view expectation,
+                        std::string_view firstExpr, std::string_view firstValue,
+                        std::string_view secondExpr,
+                        std::string_view secondValue, std::string_view file,
+                        std::size_t line,
+                        std::span<const std::string_view> expressions,
+                        std::span<const std::string_view> values);
+void reportCheckNear(CheckSite &site, std::uint64_t number,
+                     std::string_view message, std::string_view firstExpr,
+                     std::string_view firstValue, std::string_view secondExpr,
+                     std::string_view secondValue,
+                     std::string_view toleranceExpr,
+                     std::string_view toleranceValue, std::string_view file,
+                     std::size_t line,
+                     std::span<const std::string_view> expressions,
+                     std::span<const std::string_view> values);
+void reportCheckRange(CheckSite &site, std::uint64_t number,
+                      std::string_view message, std::string_view expectation,
+                      std::string_view rangeExpr, RangeExcerpt excerpt,
+                      std::string_view file, std::size_t line,
+                      std::span<const std::string_view> expressions,
+                      std::span<const std::string_view> values);
+
+/**
+ * Runs the failure branch of an assertion as a cold function of its own
+ * that is never inlined. Formatting the report and passing the arguments
+ * then stays out of the caller, which only keeps the check and a call.
+ */
+#define ERRANTIBUS_COLD_THUNK [&] [[gnu::cold, gnu::noinline, noreturn]]
+
+#define ERRANTIBUS_COLD(...) ERRANTIBUS_COLD_THUNK() { __VA_ARGS__; }()
+
+/**
+ * Binds the operands of an assertion to the parameters of a lambda that is
+ * called right away, and checks them in its body. Each operand is evaluated
+ * exactly once, and as a parameter it lives until the end of the
+ * full-expression, so even a reference into a temporary stays valid until
+ * the failure is reported. As the lambda is written out at the assertion,
+ * its inlined code keeps the assertion's line for the stack trace.
+ */
+#define ERRANTIBUS_OPERANDS [&] [[gnu::always_inline]]
+
+/**
+ * The failure branches of the assertions and checks below, run in a cold
+ * thunk that takes `parameters` and is called with `arguments`. The report
+ * is `fail<report>` for an assertion, and `reportCheck<report>` for a
+ * check, after its failure at `condition` is counted. Both are passed the
+ * message followed by the remaining arguments.
+ */
+#define ERRANTIBUS_FAIL_ASSERT(condition, parameters, arguments, report, msg,  \
+                               ...)                                            \
+  ERRANTIBUS_COLD_THUNK parameters {                                           \
+    errantibus::internal::fail##report(msg, __VA_ARGS__);                      \
+  } arguments
+
+#define ERRANTIBUS_FAIL_CHECK(condition, parameters, arguments, report, msg,   \
+                              ...)                                             \
+  ERRANTIBUS_CHECK_THUNK parameters {                                          \
+    ERRANTIBUS_CHECK_SITE(checkSite, condition);                               \
+    if (auto number =                                                          \
+            errantibus::internal::beginCheckFailure(checkSite, msg)) {         \
+      errantibus::internal::reportCheck##report(checkSite, number, msg,        \
+                                                __VA_ARGS__);                  \
+    }                                                                          \
+  } arguments
+
+/**
+ * Tests `a op b`, and runs `failure`, one of the macros above, if it does
+ * not hold. The operands are also passed as written, as `aText` and
+ * `bText`, since the arguments of a nested macro are already expanded.
+ */
+#define ERRANTIBUS_COMPARE(failure, kind, a, op, b, aText, bText,              \
+                           expectation, msg, ...)                              \
+  do {                                                                         \
+    ERRANTIBUS_BEGIN_SITE(siteProbe, kind, aText " " #op " " bText);           \
+    ERRANTIBUS_OPERANDS(const auto &aOperand, const auto &bOperand) {          \
+      if (!(aOperand op bOperand)) [[unlikely]] {                              \
+        failure(aText " " #op " " bText,                                       \
+                (const auto &aObj, const auto &bObj), (aOperand, bOperand),    \
+                Compare, msg, expectation, aText,                              \
+                errantibus::internal::formatValue(aObj), bText,                \
+                errantibus::internal::formatValue(bObj), __FILE__, __LINE__,   \
+                ERRANTIBUS_EXPRESSIONS(__VA_ARGS__),                           \
+                errantibus::internal::generateReport(__VA_ARGS__));            \
+      }                                                                        \
+    }((a), (b));                                                               \
+    ERRANTIBUS_END_SITE(siteProbe);                                            \
+  } while (false)
+
+/// Like ERRANTIBUS_COMPARE, for `a` and `b` within `tolerance`.
+#define ERRANTIBUS_NEAR(failure, kind, a, b, tolerance, aText, bText,          \
+                        toleranceText, msg, ...)                               \
+  do {                                                                         \
+    ERRANTIBUS_BEGIN_SITE(siteProbe, kind, aText " ~ " bText);                 \
+    ERRANTIBUS_OPERANDS(const auto &aOperand, const auto &bOperand,            \
+                        const auto &toleranceOperand) {                        \
+      if (!errantibus::internal::isNear(aOperand, bOperand,                    \
+                                        toleranceOperand)) [[unlikely]] {      \
+        failure(aText " ~ " bText,                                             \
+                (const auto &aObj, const auto &bObj,                           \
+                 const auto &toleranceObj),                                    \
+                (aOperand, bOperand, toleranceOperand), Near, msg, aText,      \
+                errantibus::internal::formatValue(aObj), bText,                \
+                errantibus::internal::formatValue(bObj), toleranceText,        \
+                errantibus::internal::formatValue(toleranceObj), __FILE__,     \
+                __LINE__, ERRANTIBUS_EXPRESSIONS(__VA_ARGS__),                 \
+                errantibus::internal::generateReport(__VA_ARGS__));            \
+      }                                                                        \
+    }((a), (b), (tolerance));                                                  \
+    ERRANTIBUS_END_SITE(siteProbe);                                            \
+  } while (false)
+
+/**
+ * Like ERRANTIBUS_COMPARE, for a test of all elements of `range`. `find`,
+ * called in errantibus::internal, returns the index of the first failing
+ * element of `rangeOperand`.
+ */
+#define ERRANTIBUS_RANGE(failure, kind, range, find, condition, rangeText,     \
+                         expectation, msg, ...)                                \
+  do {                                                                         \
+    ERRANTIBUS_BEGIN_SITE(siteProbe, kind, condition);                         \
+    ERRANTIBUS_OPERANDS(const auto &rangeOperand) {                            \
+      auto rangeIndex = errantibus::internal::find;                            \
+      if (rangeIndex != errantibus::internal::noIndex) [[unlikely]] {          \
+        failure(condition, (const auto &rangeObj, std::size_t index),          \
+                (rangeOperand, rangeIndex), Range, msg, expectation,           \
+                rangeText, errantibus::internal::RangeWindow(rangeObj, index), \
+                __FILE__, __LINE__, ERRANTIBUS_EXPRESSIONS(__VA_ARGS__),       \
+                errantibus::internal::generateReport(__VA_ARGS__));            \
+      }                                                                        \
+    }((range));                                                                \
+    ERRANTIBUS_END_SITE(siteProbe);                                            \
+  } while (false)
 
 #define assertAlways(cond, msg, ...)                                           \
   do {                                                                         \
+    ERRANTIBUS_BEGIN_SITE(assertProbe, "assertAlways", #cond);                 \
     bool condition = (cond);                                                   \
+    ERRANTIBUS_END_SITE(assertProbe);                                          \
     if (!condition) [[unlikely]] {                                             \
-      errantibus::internal::failAssert(                                        \
-          msg, #cond, __FILE__, __LINE__, #__VA_ARGS__,                        \
-          errantibus::internal::generateReport(__VA_ARGS__));                  \
+      ERRANTIBUS_COLD(errantibus::internal::failAssert(                        \
+          msg, #cond, __FILE__, __LINE__,                                      \
+          ERRANTIBUS_EXPRESSIONS(__VA_ARGS__),                                 \
+          errantibus::internal::generateReport(__VA_ARGS__)));                 \
     }                                                                          \
   } while (false)
 
 #define assertDbg(cond, msg, ...) assertAlways(cond, msg, __VA_ARGS__)
 
 #define assertAlwaysEq(a, b, msg, ...)                                         \
-  do {                                                                         \
-    auto aObj = (a);                                                           \
-    auto bObj = (b);                                                           \
-    bool condition = aObj == bObj;                                             \
-    if (!condition) [[unlikely]] {                                             \
-      errantibus::internal::failEq(                                            \
-          msg, #a, errantibus::internal::toString(aObj), #b,                   \
-          errantibus::internal::toString(bObj), __FILE__, __LINE__,            \
-          #__VA_ARGS__, errantibus::internal::generateReport(__VA_ARGS__));    \
-    }                                                                          \
-  } while (false)
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysEq", a, ==, b, #a,   \
+                     #b, "Should be equal, but was different:", msg,           \
+                     __VA_ARGS__)
 
 #define assertDbgEq(a, b, msg, ...) assertAlwaysEq(a, b, msg, __VA_ARGS__)
 
 #define assertAlwaysNeq(a, b, msg, ...)                                        \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysNeq", a, !=, b, #a,  \
+                     #b, "Should be different, but was equal:", msg,           \
+                     __VA_ARGS__)
+
+#define assertDbgNeq(a, b, msg, ...) assertAlwaysNeq(a, b, msg, __VA_ARGS__)
+
+#define assertAlwaysLt(a, b, msg, ...)                                         \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysLt", a, <, b, #a,    \
+                     #b, "Should be less, but was greater or equal:", msg,     \
+                     __VA_ARGS__)
+
+#define assertDbgLt(a, b, msg, ...) assertAlwaysLt(a, b, msg, __VA_ARGS__)
+
+#define assertAlwaysLe(a, b, msg, ...)                                         \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysLe", a, <=, b, #a,   \
+                     #b, "Should be less or equal, but was greater:", msg,     \
+                     __VA_ARGS__)
+
+#define assertDbgLe(a, b, msg, ...) assertAlwaysLe(a, b, msg, __VA_ARGS__)
+
+#define assertAlwaysGt(a, b, msg, ...)                                         \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysGt", a, >, b, #a,    \
+                     #b, "Should be greater, but was less or equal:", msg,     \
+                     __VA_ARGS__)
+
+#define assertDbgGt(a, b, msg, ...) assertAlwaysGt(a, b, msg, __VA_ARGS__)
+
+#define assertAlwaysGe(a, b, msg, ...)                                         \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysGe", a, >=, b, #a,   \
+                     #b, "Should be greater or equal, but was less:", msg,     \
+                     __VA_ARGS__)
+
+#define assertDbgGe(a, b, msg, ...) assertAlwaysGe(a, b, msg, __VA_ARGS__)
+
+#define assertAlwaysNear(a, b, tolerance, msg, ...)                            \
+  ERRANTIBUS_NEAR(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysNear", a, b, tolerance, \
+                  #a, #b, #tolerance, msg, __VA_ARGS__)
+
+#define assertDbgNear(a, b, tolerance, msg, ...)                               \
+  assertAlwaysNear(a, b, tolerance, msg, __VA_ARGS__)
+
+#define assertAlwaysAllInRange(range, lo, hi, msg, ...)                        \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysAllInRange", range,    \
+                   findOutOfRange(rangeOperand, (lo), (hi)),                   \
+                   #range " in [" #lo ", " #hi "]", #range,                    \
+                   "Should all be in [" #lo ", " #hi "], but one was not:",    \
+                   msg, __VA_ARGS__)
+
+#define assertDbgAllInRange(range, lo, hi, msg, ...)                           \
+  assertAlwaysAllInRange(range, lo, hi, msg, __VA_ARGS__)
+
+#define assertAlwaysSorted(range, msg, ...)                                    \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysSorted", range,        \
+                   findUnsorted(rangeOperand), #range " sorted", #range,       \
+                   "Should be sorted, but one was less than the one before:",  \
+                   msg, __VA_ARGS__)
+
+#define assertDbgSorted(range, msg, ...)                                       \
+  assertAlwaysSorted(range, msg, __VA_ARGS__)
+
+#define assertAlwaysNoNaN(range, msg, ...)                                     \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysNoNaN", range,         \
+                   findNaN(rangeOperand), #range " without NaN", #range,       \
+                   "Should contain no NaN, but one was NaN:", msg,             \
+                   __VA_ARGS__)
+
+#define assertDbgNoNaN(range, msg, ...)                                        \
+  assertAlwaysNoNaN(range, msg, __VA_ARGS__)
+
+/**
+ * Arrays of numbers are tested in blocks of 64, so `predicate` may also be
+ * called for elements after the first failing one, up to the end of its
+ * block. It should not have side effects or rely on the elements before.
+ * Other ranges are tested one element at a time, like std::all_of.
+ */
+#define assertAlwaysAll(range, predicate, msg, ...)                            \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_ASSERT, "assertAlwaysAll", range,           \
+                   findFirstFailing(rangeOperand, (predicate)),                \
+                   #predicate " for all of " #range, #range,                   \
+                   "Should all satisfy " #predicate ", but one did not:", msg, \
+                   __VA_ARGS__)
+
+#define assertDbgAll(range, predicate, msg, ...)                               \
+  assertAlwaysAll(range, predicate, msg, __VA_ARGS__)
+
+#define checkAlways(cond, msg, ...)                                            \
   do {                                                                         \
-    auto aObj = (a);                                                           \
-    auto bObj = (b);                                                           \
-    bool condition = aObj != bObj;                                             \
+    ERRANTIBUS_BEGIN_SITE(checkProbe, "checkAlways", #cond);                   \
+    bool condition = (cond);                                                   \
+    ERRANTIBUS_END_SITE(checkProbe);                                           \
     if (!condition) [[unlikely]] {                                             \
-      errantibus::internal::failNeq(                                           \
-          msg, #a, errantibus::internal::toString(aObj), #b,                   \
-          errantibus::internal::toString(bObj), __FILE__, __LINE__,            \
-          #__VA_ARGS__, errantibus::internal::generateReport(__VA_ARGS__));    \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #cond);                               \
+        if (auto number =                                                      \
+                errantibus::internal::beginCheckFailure(checkSite, msg)) {     \
+          errantibus::internal::reportCheckAssert(                             \
+              checkSite, number, msg, #cond, __FILE__, __LINE__,               \
+              ERRANTIBUS_EXPRESSIONS(__VA_ARGS__),                             \
+              errantibus::internal::generateReport(__VA_ARGS__));              \
+        }                                                                      \
+      }();                                                                     \
     }                                                                          \
   } while (false)
 
-#define assertDbgNeq(a, b, msg, ...) assertAlwaysNeq(a, b, msg, __VA_ARGS__)
+#define checkDbg(cond, msg, ...) checkAlways(cond, msg, __VA_ARGS__)
+
+#define checkAlwaysEq(a, b, msg, ...)                                          \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysEq", a, ==, b, #a, #b, \
+                     "Should be equal, but was different:", msg, __VA_ARGS__)
+
+#define checkDbgEq(a, b, msg, ...) checkAlwaysEq(a, b, msg, __VA_ARGS__)
+
+#define checkAlwaysNeq(a, b, msg, ...)                                         \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysNeq", a, !=, b, #a,    \
+                     #b, "Should be different, but was equal:", msg,           \
+                     __VA_ARGS__)
+
+#define checkDbgNeq(a, b, msg, ...) checkAlwaysNeq(a, b, msg, __VA_ARGS__)
+
+#define checkAlwaysLt(a, b, msg, ...)                                          \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysLt", a, <, b, #a, #b,  \
+                     "Should be less, but was greater or equal:", msg,         \
+                     __VA_ARGS__)
+
+#define checkDbgLt(a, b, msg, ...) checkAlwaysLt(a, b, msg, __VA_ARGS__)
+
+#define checkAlwaysLe(a, b, msg, ...)                                          \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysLe", a, <=, b, #a, #b, \
+                     "Should be less or equal, but was greater:", msg,         \
+                     __VA_ARGS__)
+
+#define checkDbgLe(a, b, msg, ...) checkAlwaysLe(a, b, msg, __VA_ARGS__)
+
+#define checkAlwaysGt(a, b, msg, ...)                                          \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysGt", a, >, b, #a, #b,  \
+                     "Should be greater, but was less or equal:", msg,         \
+                     __VA_ARGS__)
+
+#define checkDbgGt(a, b, msg, ...) checkAlwaysGt(a, b, msg, __VA_ARGS__)
+
+#define checkAlwaysGe(a, b, msg, ...)                                          \
+  ERRANTIBUS_COMPARE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysGe", a, >=, b, #a, #b, \
+                     "Should be greater or equal, but was less:", msg,         \
+                     __VA_ARGS__)
+
+#define checkDbgGe(a, b, msg, ...) checkAlwaysGe(a, b, msg, __VA_ARGS__)
+
+#define checkAlwaysNear(a, b, tolerance, msg, ...)                             \
+  ERRANTIBUS_NEAR(ERRANTIBUS_FAIL_CHECK, "checkAlwaysNear", a, b, tolerance,   \
+                  #a, #b, #tolerance, msg, __VA_ARGS__)
+
+#define checkDbgNear(a, b, tolerance, msg, ...)                                \
+  checkAlwaysNear(a, b, tolerance, msg, __VA_ARGS__)
+
+#define checkAlwaysAllInRange(range, lo, hi, msg, ...)                         \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysAllInRange", range,      \
+                   findOutOfRange(rangeOperand, (lo), (hi)),                   \
+                   #range " in [" #lo ", " #hi "]", #range,                    \
+                   "Should all be in [" #lo ", " #hi "], but one was not:",    \
+                   msg, __VA_ARGS__)
+
+#define checkDbgAllInRange(range, lo, hi, msg, ...)                            \
+  checkAlwaysAllInRange(range, lo, hi, msg, __VA_ARGS__)
+
+#define checkAlwaysSorted(range, msg, ...)                                     \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysSorted", range,          \
+                   findUnsorted(rangeOperand), #range " sorted", #range,       \
+                   "Should be sorted, but one was less than the one before:",  \
+                   msg, __VA_ARGS__)
+
+#define checkDbgSorted(range, msg, ...)                                        \
+  checkAlwaysSorted(range, msg, __VA_ARGS__)
+
+#define checkAlwaysNoNaN(range, msg, ...)                                      \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysNoNaN", range,           \
+                   findNaN(rangeOperand), #range " without NaN", #range,       \
+                   "Should contain no NaN, but one was NaN:", msg,             \
+                   __VA_ARGS__)
+
+#define checkDbgNoNaN(range, msg, ...) checkAlwaysNoNaN(range, msg, __VA_ARGS__)
+
+#define checkAlwaysAll(range, predicate, msg, ...)                             \
+  ERRANTIBUS_RANGE(ERRANTIBUS_FAIL_CHECK, "checkAlwaysAll", range,             \
+                   findFirstFailing(rangeOperand, (predicate)),                \
+                   #predicate " for all of " #range, #range,                   \
+                   "Should all satisfy " #predicate ", but one did not:", msg, \
+                   __VA_ARGS__)
+
+#define checkDbgAll(range, predicate, msg, ...)                                \
+  checkAlwaysAll(range, predicate, msg, __VA_ARGS__)
+
+#define assertAsync(snapshot, predicate, msg, ...)                             \
+  do {                                                                         \
+    errantibus::internal::verifyAsync((snapshot), (predicate), [&] {           \
+      return [assertMessage = static_cast<const char *>(msg),                  \
+              assertArguments = std::make_tuple(__VA_ARGS__)](                 \
+                 const errantibus::internal::AsyncOrigin *origin) {            \
+        std::apply(                                                            \
+            [&](const auto &...arguments) {                                    \
+              errantibus::internal::failAsync(                                 \
+                  assertMessage, #predicate "(" #snapshot ")", __FILE__,       \
+                  __LINE__, origin, ERRANTIBUS_EXPRESSIONS(__VA_ARGS__),       \
+                  errantibus::internal::generateReport(arguments...));         \
+            },                                                                 \
+            assertArguments);                                                  \
+      };                                                                       \
+    });                                                                        \
+  } while (false)
 
 #define failAlways(msg, ...)                                                   \
   do {                                                                         \
-    errantibus::internal::fail(                                                \
-        msg, __FILE__, __LINE__, #__VA_ARGS__,                                 \
-        errantibus::internal::generateReport(__VA_ARGS__));                    \
+    ERRANTIBUS_COLD(errantibus::internal::fail(                                \
+        msg, __FILE__, __LINE__, ERRANTIBUS_EXPRESSIONS(__VA_ARGS__),          \
+        errantibus::internal::generateReport(__VA_ARGS__)));                   \
   } while (false)
 
 #define failDbg(msg, ...) failAlways(msg, __VA_ARGS__)
 
 #define debug(...)                                                             \
   do {                                                                         \
-    errantibus::internal::printDebug(                                          \
-        __FILE__, __LINE__, #__VA_ARGS__,                                      \
-        errantibus::internal::generateReport(__VA_ARGS__));                    \
+    static constexpr errantibus::internal::DebugSite debugSite{                \
+        __FILE__, __LINE__, ERRANTIBUS_EXPRESSIONS(__VA_ARGS__)};              \
+    if (errantibus::internal::asyncDebugEnabled()) {                           \
+      errantibus::internal::enqueueDebug(                                      \
+          debugSite __VA_OPT__(, ) __VA_ARGS__);                               \
+    } else {                                                                   \
+      errantibus::internal::printDebug(                                        \
+          __FILE__, __LINE__, debugSite.expressions,                           \
+          errantibus::internal::generateReport(__VA_ARGS__));                  \
+    }                                                                          \
+  } while (false)
+
+#define errantibusRecord(...)                                                  \
+  do {                                                                         \
+    static constexpr errantibus::internal::DebugSite recordSite{               \
+        __FILE__, __LINE__, ERRANTIBUS_EXPRESSIONS(__VA_ARGS__)};              \
+    errantibus::internal::recordEvent(recordSite __VA_OPT__(, ) __VA_ARGS__);  \
   } while (false)
 
 } // namespace errantibus::internal
 
+template <typename T>
+void errantibus::Writer::value(const T &obj) {
+  internal::stringify(*this, obj);
+}
+
 #endif
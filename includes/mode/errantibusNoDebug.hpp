@@ -3,8 +3,18 @@
  * See <https://github.com/jakobteuber/errantibus>
  */
 
-#ifndef ERRANTIBUS_DEFINITIONS_HPP
-#define ERRANTIBUS_DEFINITIONS_HPP
+#ifndef ERRANTIBUS_NODEBUG_DEFINITIONS_HPP
+#define ERRANTIBUS_NODEBUG_DEFINITIONS_HPP
+
+#include "errantibus/asyncAssert.hpp"
+#include "errantibus/checks.hpp"
+#include "errantibus/ranges.hpp"
+#include "errantibus/relations.hpp"
+#include "errantibus/sampled.hpp"
+#include "errantibus/switchable.hpp"
+
+#include <cstdlib>
+#include <string_view>
 
 namespace errantibus::internal {
 
@@ -12,7 +22,7 @@ namespace errantibus::internal {
  * @brief Marks an unreachable program location. In your own program
  * prefer std::unreachable from <utility>.
  */
-[[noreturn]] inline void unrearchable() {
+[[noreturn]] inline void unreachable() {
   // Uses compiler specific extensions if possible.
   // Even if no extension is used, undefined behavior is still raised by
   // an empty function body and the noreturn attribute.
@@ -23,12 +33,70 @@ namespace errantibus::internal {
 #endif
 }
 
+/**
+ * @brief Stop the program as cheaply as possible, without a report.
+ */
+[[noreturn]] inline void trap() {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_trap();
+#else
+  std::abort();
+#endif
+}
+
 /**
  * @brief Provide a minimal failure notice and terminate the program.
  */
 [[noreturn]] void failNote(const char *message, const char *file,
                            unsigned line);
 
+/**
+ * @brief Count a failure of a check, and pass it to the check handler with
+ * a minimal report.
+ */
+void noteCheckFailure(CheckSite &site, std::string_view message);
+
+} // namespace errantibus::internal
+
+/*
+ * The debug assertions become assumptions: the condition is not evaluated,
+ * but the optimizer may rely on it. With ERRANTIBUS_VERIFY_ASSUMPTIONS, they
+ * are checked instead and trap if they do not hold, to test the assumptions
+ * of a release build before shipping it.
+ *
+ * GCC before version 13 has no way to assume a condition without
+ * evaluating it. There, it is evaluated and followed by an unreachable
+ * branch, which only leaves out conditions the optimizer can see through.
+ */
+#if defined(ERRANTIBUS_VERIFY_ASSUMPTIONS)
+#define ERRANTIBUS_ASSUME(cond)                                                \
+  if (!(cond)) [[unlikely]] {                                                  \
+    errantibus::internal::trap();                                              \
+  }
+#elif __has_cpp_attribute(assume) >= 202207L
+#define ERRANTIBUS_ASSUME(cond) [[assume(cond)]]
+#elif defined(__clang__)
+#define ERRANTIBUS_ASSUME(cond) __builtin_assume(cond)
+#elif defined(_MSC_VER)
+#define ERRANTIBUS_ASSUME(cond) __assume(cond)
+#else
+#define ERRANTIBUS_ASSUME(cond)                                                \
+  if (!(cond)) {                                                               \
+    errantibus::internal::unreachable();                                       \
+  }
+#endif
+
+/*
+ * Range assertions are not assumed, since they could not be assumed without
+ * the very pass over the range that a release build wants to avoid. They are
+ * dropped entirely, unless assumptions are verified.
+ */
+#if defined(ERRANTIBUS_VERIFY_ASSUMPTIONS)
+#define ERRANTIBUS_VERIFY_ONLY(cond) ERRANTIBUS_ASSUME(cond)
+#else
+#define ERRANTIBUS_VERIFY_ONLY(cond) static_cast<void>(sizeof(cond))
+#endif
+
 #define assertAlways(cond, msg, ...)                                           \
   do {                                                                         \
     bool condition = (cond);                                                   \
@@ -39,17 +107,12 @@ namespace errantibus::internal {
 
 #define assertDbg(cond, msg, ...)                                              \
   do {                                                                         \
-    bool condition = (cond);                                                   \
-    if (!condition) {                                                          \
-      errantibus::internal::unreachable();                                     \
-    }                                                                          \
+    ERRANTIBUS_ASSUME((cond));                                                 \
   } while (false)
 
 #define assertAlwaysEq(a, b, msg, ...)                                         \
   do {                                                                         \
-    auto aObj = (a);                                                           \
-    auto bObj = (b);                                                           \
-    bool condition = aObj == bObj;                                             \
+    bool condition = (a) == (b);                                               \
     if (!condition) [[unlikely]] {                                             \
       errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
     }                                                                          \
@@ -57,17 +120,12 @@ namespace errantibus::internal {
 
 #define assertDbgEq(a, b, msg, ...)                                            \
   do {                                                                         \
-    bool condition = (a) == (b);                                               \
-    if (!condition) {                                                          \
-      errantibus::internal::unreachable();                                     \
-    }                                                                          \
+    ERRANTIBUS_ASSUME((a) == (b));                                             \
   } while (false)
 
 #define assertAlwaysNeq(a, b, msg, ...)                                        \
   do {                                                                         \
-    auto aObj = (a);                                                           \
-    auto bObj = (b);                                                           \
-    bool condition = aObj != bObj;                                             \
+    bool condition = (a) != (b);                                               \
     if (!condition) [[unlikely]] {                                             \
       errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
     }                                                                          \
@@ -75,26 +133,366 @@ namespace errantibus::internal {
 
 #define assertDbgNeq(a, b, msg, ...)                                           \
   do {                                                                         \
-    bool condition = (a) != (b);                                               \
-    if (!condition) {                                                          \
-      errantibus::internal::unreachable();                                     \
+    ERRANTIBUS_ASSUME((a) != (b));                                             \
+  } while (false)
+
+#define assertAlwaysLt(a, b, msg, ...)                                         \
+  do {                                                                         \
+    bool condition = (a) < (b);                                                \
+    if (!condition) [[unlikely]] {                                             \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgLt(a, b, msg, ...)                                            \
+  do {                                                                         \
+    ERRANTIBUS_ASSUME((a) < (b));                                              \
+  } while (false)
+
+#define assertAlwaysLe(a, b, msg, ...)                                         \
+  do {                                                                         \
+    bool condition = (a) <= (b);                                               \
+    if (!condition) [[unlikely]] {                                             \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgLe(a, b, msg, ...)                                            \
+  do {                                                                         \
+    ERRANTIBUS_ASSUME((a) <= (b));                                             \
+  } while (false)
+
+#define assertAlwaysGt(a, b, msg, ...)                                         \
+  do {                                                                         \
+    bool condition = (a) > (b);                                                \
+    if (!condition) [[unlikely]] {                                             \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgGt(a, b, msg, ...)                                            \
+  do {                                                                         \
+    ERRANTIBUS_ASSUME((a) > (b));                                              \
+  } while (false)
+
+#define assertAlwaysGe(a, b, msg, ...)                                         \
+  do {                                                                         \
+    bool condition = (a) >= (b);                                               \
+    if (!condition) [[unlikely]] {                                             \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgGe(a, b, msg, ...)                                            \
+  do {                                                                         \
+    ERRANTIBUS_ASSUME((a) >= (b));                                             \
+  } while (false)
+
+#define assertAlwaysNear(a, b, tolerance, msg, ...)                            \
+  do {                                                                         \
+    bool condition = errantibus::internal::isNear((a), (b), (tolerance));      \
+    if (!condition) [[unlikely]] {                                             \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgNear(a, b, tolerance, msg, ...)                               \
+  do {                                                                         \
+    ERRANTIBUS_ASSUME(errantibus::internal::isNear((a), (b), (tolerance)));    \
+  } while (false)
+
+#define assertAlwaysAllInRange(range, lo, hi, msg, ...)                        \
+  do {                                                                         \
+    if (errantibus::internal::findOutOfRange((range), (lo), (hi)) !=           \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgAllInRange(range, lo, hi, msg, ...)                           \
+  do {                                                                         \
+    ERRANTIBUS_VERIFY_ONLY(                                                    \
+        errantibus::internal::findOutOfRange((range), (lo), (hi)) ==           \
+        errantibus::internal::noIndex);                                        \
+  } while (false)
+
+#define assertAlwaysSorted(range, msg, ...)                                    \
+  do {                                                                         \
+    if (errantibus::internal::findUnsorted((range)) !=                         \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgSorted(range, msg, ...)                                       \
+  do {                                                                         \
+    ERRANTIBUS_VERIFY_ONLY(                                                    \
+        errantibus::internal::findUnsorted((range)) ==                         \
+        errantibus::internal::noIndex);                                        \
+  } while (false)
+
+#define assertAlwaysNoNaN(range, msg, ...)                                     \
+  do {                                                                         \
+    if (errantibus::internal::findNaN((range)) !=                              \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgNoNaN(range, msg, ...)                                        \
+  do {                                                                         \
+    ERRANTIBUS_VERIFY_ONLY(                                                    \
+        errantibus::internal::findNaN((range)) ==                              \
+        errantibus::internal::noIndex);                                        \
+  } while (false)
+
+#define assertAlwaysAll(range, predicate, msg, ...)                            \
+  do {                                                                         \
+    if (errantibus::internal::findFirstFailing((range), (predicate)) !=        \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      errantibus::internal::failNote(msg, __FILE__, __LINE__);                 \
+    }                                                                          \
+  } while (false)
+
+#define assertDbgAll(range, predicate, msg, ...)                               \
+  do {                                                                         \
+    ERRANTIBUS_VERIFY_ONLY(                                                    \
+        errantibus::internal::findFirstFailing((range), (predicate)) ==        \
+        errantibus::internal::noIndex);                                        \
+  } while (false)
+
+/*
+ * Checks report and continue, so they stay on in release builds, with the
+ * minimal report of failNote. The `checkDbg` forms are not turned into
+ * assumptions like `assertDbg`, as a failing check is expected to happen and
+ * must not be undefined behavior; they are left out instead.
+ */
+#define checkAlways(cond, msg, ...)                                            \
+  do {                                                                         \
+    if (!(cond)) [[unlikely]] {                                                \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #cond);                               \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbg(cond, msg, ...)                                               \
+  do {                                                                         \
+    static_cast<void>(sizeof((cond)));                                         \
+  } while (false)
+
+#define checkAlwaysEq(a, b, msg, ...)                                          \
+  do {                                                                         \
+    if (!((a) == (b))) [[unlikely]] {                                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #a " == " #b);                        \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgEq(a, b, msg, ...)                                             \
+  do {                                                                         \
+    static_cast<void>(sizeof((a) == (b)));                                     \
+  } while (false)
+
+#define checkAlwaysNeq(a, b, msg, ...)                                         \
+  do {                                                                         \
+    if (!((a) != (b))) [[unlikely]] {                                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #a " != " #b);                        \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgNeq(a, b, msg, ...)                                            \
+  do {                                                                         \
+    static_cast<void>(sizeof((a) != (b)));                                     \
+  } while (false)
+
+#define checkAlwaysLt(a, b, msg, ...)                                          \
+  do {                                                                         \
+    if (!((a) < (b))) [[unlikely]] {                                           \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #a " < " #b);                         \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgLt(a, b, msg, ...)                                             \
+  do {                                                                         \
+    static_cast<void>(sizeof((a) < (b)));                                      \
+  } while (false)
+
+#define checkAlwaysLe(a, b, msg, ...)                                          \
+  do {                                                                         \
+    if (!((a) <= (b))) [[unlikely]] {                                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #a " <= " #b);                        \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgLe(a, b, msg, ...)                                             \
+  do {                                                                         \
+    static_cast<void>(sizeof((a) <= (b)));                                     \
+  } while (false)
+
+#define checkAlwaysGt(a, b, msg, ...)                                          \
+  do {                                                                         \
+    if (!((a) > (b))) [[unlikely]] {                                           \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #a " > " #b);                         \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgGt(a, b, msg, ...)                                             \
+  do {                                                                         \
+    static_cast<void>(sizeof((a) > (b)));                                      \
+  } while (false)
+
+#define checkAlwaysGe(a, b, msg, ...)                                          \
+  do {                                                                         \
+    if (!((a) >= (b))) [[unlikely]] {                                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #a " >= " #b);                        \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgGe(a, b, msg, ...)                                             \
+  do {                                                                         \
+    static_cast<void>(sizeof((a) >= (b)));                                     \
+  } while (false)
+
+#define checkAlwaysNear(a, b, tolerance, msg, ...)                             \
+  do {                                                                         \
+    if (!errantibus::internal::isNear((a), (b), (tolerance))) [[unlikely]] {   \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #a " ~ " #b);                         \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgNear(a, b, tolerance, msg, ...)                                \
+  do {                                                                         \
+    static_cast<void>(                                                         \
+        sizeof(errantibus::internal::isNear((a), (b), (tolerance))));          \
+  } while (false)
+
+#define checkAlwaysAllInRange(range, lo, hi, msg, ...)                         \
+  do {                                                                         \
+    if (errantibus::internal::findOutOfRange((range), (lo), (hi)) !=           \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #range " in [" #lo ", " #hi "]");     \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgAllInRange(range, lo, hi, msg, ...)                            \
+  do {                                                                         \
+    static_cast<void>(                                                         \
+        sizeof(errantibus::internal::findOutOfRange((range), (lo), (hi)) ==    \
+               errantibus::internal::noIndex));                                \
+  } while (false)
+
+#define checkAlwaysSorted(range, msg, ...)                                     \
+  do {                                                                         \
+    if (errantibus::internal::findUnsorted((range)) !=                         \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #range " sorted");                    \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgSorted(range, msg, ...)                                        \
+  do {                                                                         \
+    static_cast<void>(                                                         \
+        sizeof(errantibus::internal::findUnsorted((range)) ==                  \
+               errantibus::internal::noIndex));                                \
+  } while (false)
+
+#define checkAlwaysNoNaN(range, msg, ...)                                      \
+  do {                                                                         \
+    if (errantibus::internal::findNaN((range)) !=                              \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #range " without NaN");               \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
     }                                                                          \
   } while (false)
 
+#define checkDbgNoNaN(range, msg, ...)                                         \
+  do {                                                                         \
+    static_cast<void>(                                                         \
+        sizeof(errantibus::internal::findNaN((range)) ==                       \
+               errantibus::internal::noIndex));                                \
+  } while (false)
+
+#define checkAlwaysAll(range, predicate, msg, ...)                             \
+  do {                                                                         \
+    if (errantibus::internal::findFirstFailing((range), (predicate)) !=        \
+        errantibus::internal::noIndex) [[unlikely]] {                          \
+      ERRANTIBUS_CHECK_THUNK() {                                               \
+        ERRANTIBUS_CHECK_SITE(checkSite, #predicate " for all of " #range);    \
+        errantibus::internal::noteCheckFailure(checkSite, msg);                \
+      }();                                                                     \
+    }                                                                          \
+  } while (false)
+
+#define checkDbgAll(range, predicate, msg, ...)                                \
+  do {                                                                         \
+    static_cast<void>(                                                         \
+        sizeof(errantibus::internal::findFirstFailing((range), (predicate)) == \
+               errantibus::internal::noIndex));                                \
+  } while (false)
+
+#define assertAsync(snapshot, predicate, msg, ...)                             \
+  do {                                                                         \
+    errantibus::internal::verifyAsync((snapshot), (predicate), [&] {           \
+      return [assertMessage = static_cast<const char *>(msg)](                 \
+                 const errantibus::internal::AsyncOrigin *) {                  \
+        errantibus::internal::failNote(assertMessage, __FILE__, __LINE__);     \
+      };                                                                       \
+    });                                                                        \
+  } while (false)
+
 #define failAlways(msg, ...)                                                   \
   do {                                                                         \
     errantibus::internal::failNote(msg, __FILE__, __LINE__);                   \
   } while (false)
 
+#if defined(ERRANTIBUS_VERIFY_ASSUMPTIONS)
+#define failDbg(msg, ...)                                                      \
+  do {                                                                         \
+    errantibus::internal::trap();                                              \
+  } while (false)
+#else
 #define failDbg(msg, ...)                                                      \
   do {                                                                         \
     errantibus::internal::unreachable();                                       \
   } while (false)
+#endif
 
 #define debug(...)                                                             \
   do {                                                                         \
   } while (false)
 
-} // namespace errantibus::internal
+#define errantibusRecord(...)                                                  \
+  do {                                                                         \
+  } while (false)
 
 #endif
@@ -0,0 +1,267 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/asyncAssert.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace errantibus::internal {
+
+namespace {
+
+/// Verifications handed to one worker. Idle workers steal from the others.
+struct WorkerQueue {
+  std::mutex mutex;
+  std::deque<Verification *> verifications;
+};
+
+/**
+ * @brief Workers that evaluate asynchronous assertions. Each has its own
+ * queue, which it takes from the front of; when it is empty, the worker
+ * steals from the back of the others, so one slow verification does not
+ * hold up those queued behind it.
+ */
+class VerificationPool {
+public:
+  static auto instance() -> VerificationPool & {
+    // Leaked, so that workers never outlive it during shutdown.
+    static auto *pool = new VerificationPool();
+    return *pool;
+  }
+
+  void enable(const AsyncAssertOptions &options) {
+    auto control = std::lock_guard(controlMutex);
+    // Registered the first time the pool starts, see flushAtExit().
+    [[maybe_unused]] static const bool atExit = [] {
+      // Reports flush the asynchronous debug output, which is destroyed at
+      // exit. Created first, it is destroyed after the handler has run.
+      flushAsyncDebug();
+      std::atexit(&flushAtExit);
+      std::at_quick_exit(&flushAtExit);
+      return true;
+    }();
+    stop();
+    auto threads = options.threads != 0
+                       ? options.threads
+                       : std::max(1U, std::thread::hardware_concurrency());
+    capacity = std::max<std::size_t>(options.queueCapacity, 1);
+    overflow = options.overflow;
+    stopping = false;
+    queues.clear();
+    for (std::size_t i = 0; i < threads; ++i) {
+      queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers.emplace_back([this, i] { run(i); });
+    }
+    active.store(true);
+  }
+
+  void disable() {
+    auto control = std::lock_guard(controlMutex);
+    stop();
+  }
+
+  auto admit() -> Admission {
+    // Counted before `active` is read, so that stop() waits for this
+    // verification if it has not seen it inactive.
+    outstanding.fetch_add(1);
+    if (!active.load() || onWorker) {
+      finish();
+      return Admission::inactive;
+    }
+    while (queued.fetch_add(1) >= capacity) {
+      queued.fetch_sub(1);
+      if (overflow == OverflowPolicy::drop) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        finish();
+        return Admission::dropped;
+      }
+      auto lock = std::unique_lock(wakeMutex);
+      room.wait(lock, [&] { return queued.load() < capacity; });
+    }
+    return Admission::admitted;
+  }
+
+  void cancel() {
+    queued.fetch_sub(1);
+    finish();
+  }
+
+  void submit(Verification *verification) {
+    verification->origin.thread = static_cast<std::uint64_t>(::gettid());
+    // Each thread hands its verifications to the workers in turn.
+    thread_local std::size_t next = static_cast<std::size_t>(::gettid());
+    auto &queue = *queues[next++ % queues.size()];
+    {
+      auto lock = std::lock_guard(queue.mutex);
+      queue.verifications.push_back(verification);
+    }
+    available.fetch_add(1);
+    // Notified under the lock, so that a worker cannot miss it between
+    // checking for verifications and starting to wait.
+    auto lock = std::lock_guard(wakeMutex);
+    wake.notify_one();
+  }
+
+  void flush() {
+    auto lock = std::unique_lock(wakeMutex);
+    idle.wait(lock, [&] { return outstanding.load() == 0; });
+  }
+
+  auto droppedVerifications() const -> std::uint64_t {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  VerificationPool() = default;
+
+  /**
+   * @brief Verify what is still queued when the process exits, which would
+   * otherwise be lost with the workers. Assertions made from here on are
+   * evaluated on the calling thread. A verification that exits itself
+   * cannot wait for the others, and skips this.
+   */
+  static void flushAtExit() {
+    auto &pool = instance();
+    if (!pool.active.exchange(false) || onWorker) {
+      return;
+    }
+    pool.flush();
+  }
+
+  /// Verify everything admitted so far, then end the workers.
+  void stop() {
+    active.store(false);
+    flush();
+    {
+      auto lock = std::lock_guard(wakeMutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    workers.clear();
+  }
+
+  void finish() {
+    if (outstanding.fetch_sub(1) == 1) {
+      auto lock = std::lock_guard(wakeMutex);
+      idle.notify_all();
+    }
+  }
+
+  auto take(std::size_t index) -> Verification * {
+    for (std::size_t k = 0; k < queues.size(); ++k) {
+      auto &queue = *queues[(index + k) % queues.size()];
+      auto lock = std::lock_guard(queue.mutex);
+      if (queue.verifications.empty()) {
+        continue;
+      }
+      Verification *verification = nullptr;
+      if (k == 0) {
+        verification = queue.verifications.front();
+        queue.verifications.pop_front();
+      } else {
+        verification = queue.verifications.back();
+        queue.verifications.pop_back();
+      }
+      available.fetch_sub(1);
+      return verification;
+    }
+    return nullptr;
+  }
+
+  void run(std::size_t index) {
+    onWorker = true;
+    while (true) {
+      if (auto *verification = take(index)) {
+        queued.fetch_sub(1);
+        if (overflow == OverflowPolicy::block) {
+          auto lock = std::lock_guard(wakeMutex);
+          room.notify_one();
+        }
+        verification->run(verification);
+        finish();
+        continue;
+      }
+      auto lock = std::unique_lock(wakeMutex);
+      wake.wait(lock, [&] { return available.load() > 0 || stopping; });
+      if (stopping && available.load() == 0) {
+        return;
+      }
+    }
+  }
+
+  std::mutex controlMutex;
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> workers;
+  std::size_t capacity = 0;
+  OverflowPolicy overflow = OverflowPolicy::block;
+
+  std::atomic<bool> active = false;
+  /// Admitted and not yet evaluated, including those being evaluated.
+  std::atomic<std::size_t> outstanding = 0;
+  /// Admitted and not yet taken by a worker.
+  std::atomic<std::size_t> queued = 0;
+  /// Submitted and not yet taken by a worker.
+  std::atomic<std::size_t> available = 0;
+  std::atomic<std::uint64_t> dropped = 0;
+
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  std::condition_variable room;
+  std::condition_variable idle;
+  bool stopping = false;
+
+  /// Assertions made by a verification run on its worker, which must not
+  /// wait for room in the queue it is supposed to empty.
+  static thread_local bool onWorker;
+};
+
+thread_local bool VerificationPool::onWorker = false;
+
+} // namespace
+
+auto admitVerification() -> Admission {
+  return VerificationPool::instance().admit();
+}
+
+void cancelVerification() { VerificationPool::instance().cancel(); }
+
+void submitVerification(Verification *verification) {
+  VerificationPool::instance().submit(verification);
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void enableAsyncAssertions(const AsyncAssertOptions &options) {
+  internal::VerificationPool::instance().enable(options);
+}
+
+void disableAsyncAssertions() {
+  internal::VerificationPool::instance().disable();
+}
+
+void flushAsyncAssertions() { internal::VerificationPool::instance().flush(); }
+
+auto droppedAsyncAssertions() -> std::uint64_t {
+  return internal::VerificationPool::instance().droppedVerifications();
+}
+
+} // namespace errantibus
@@ -0,0 +1,361 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/asyncDebug.hpp"
+#include "errantibus/format.hpp"
+#include "report.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace errantibus::internal {
+
+std::atomic<bool> asyncDebugActive = false;
+
+namespace {
+
+constexpr std::size_t cacheLine = 64;
+constexpr std::size_t minRingBytes = std::size_t{1} << 12;
+constexpr std::size_t maxRingBytes = std::size_t{1} << 30;
+
+/**
+ * @brief A single-producer, single-consumer byte ring. The owning thread
+ * appends records, the background thread consumes them. Records never wrap
+ * around the end of the buffer; a padding record fills the gap instead.
+ */
+class Ring {
+public:
+  explicit Ring(std::size_t capacity) :
+      capacity(capacity), buffer(static_cast<std::byte *>(::operator new(
+                              capacity, std::align_val_t{cacheLine}))) {}
+
+  Ring(const Ring &) = delete;
+  Ring(Ring &&) = delete;
+  auto operator=(const Ring &) -> Ring & = delete;
+  auto operator=(Ring &&) -> Ring & = delete;
+
+  ~Ring() { ::operator delete(buffer, std::align_val_t{cacheLine}); }
+
+  /**
+   * @brief Space for a record of `size` bytes, or nullptr if it is dropped.
+   * A record that does not fit before the end of the buffer starts over at
+   * its beginning, after padding. Padding and record together only fit into
+   * the buffer if the record takes at most half of it, so larger records are
+   * always dropped: waiting for room for them could take forever.
+   */
+  auto reserve(std::size_t size, OverflowPolicy policy) -> std::byte * {
+    if (size > capacity / 2) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    auto start = head.load(std::memory_order_relaxed);
+    auto offset = start & (capacity - 1);
+    auto contiguous = capacity - offset;
+    auto needed = size <= contiguous ? size : contiguous + size;
+    while (start + needed - cachedTail > capacity) {
+      cachedTail = tail.load(std::memory_order_acquire);
+      if (start + needed - cachedTail <= capacity) {
+        break;
+      }
+      if (policy == OverflowPolicy::drop || !asyncDebugEnabled()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      std::this_thread::yield();
+    }
+    if (size > contiguous) {
+      auto padding = RecordHeader{nullptr,
+                                  static_cast<std::uint32_t>(contiguous), 0};
+      std::memcpy(buffer + offset, &padding, sizeof(padding));
+      start += contiguous;
+    }
+    pending = start;
+    return buffer + (start & (capacity - 1));
+  }
+
+  void commit(std::size_t size) {
+    head.store(pending + size, std::memory_order_release);
+  }
+
+  /**
+   * @brief Consume all published records, calling `process` on each.
+   * Returns whether there was anything to consume.
+   */
+  template <typename Process>
+  auto drain(Process process) -> bool {
+    auto position = tail.load(std::memory_order_relaxed);
+    auto end = head.load(std::memory_order_acquire);
+    if (position == end) {
+      return false;
+    }
+    while (position != end) {
+      const std::byte *record = buffer + (position & (capacity - 1));
+      auto header = RecordHeader();
+      std::memcpy(&header, record, sizeof(header));
+      if (header.site != nullptr) {
+        process(record, header);
+      }
+      position += header.size;
+      tail.store(position, std::memory_order_release);
+    }
+    return true;
+  }
+
+  auto empty() const -> bool {
+    return tail.load(std::memory_order_acquire) ==
+           head.load(std::memory_order_acquire);
+  }
+
+  std::atomic<bool> closed = false;
+  std::atomic<std::uint64_t> dropped = 0;
+
+private:
+  const std::size_t capacity;
+  std::byte *const buffer;
+
+  alignas(cacheLine) std::atomic<std::uint64_t> head = 0;
+  std::uint64_t pending = 0;
+  std::uint64_t cachedTail = 0;
+
+  alignas(cacheLine) std::atomic<std::uint64_t> tail = 0;
+};
+
+class AsyncDebug {
+public:
+  AsyncDebug() = default;
+  AsyncDebug(const AsyncDebug &) = delete;
+  AsyncDebug(AsyncDebug &&) = delete;
+  auto operator=(const AsyncDebug &) -> AsyncDebug & = delete;
+  auto operator=(AsyncDebug &&) -> AsyncDebug & = delete;
+
+  ~AsyncDebug() { disable(); }
+
+  void enable(const AsyncDebugOptions &newOptions) {
+    auto control = std::lock_guard(controlMutex);
+    {
+      auto registry = std::lock_guard(registryMutex);
+      ringBytes = std::clamp(std::bit_ceil(newOptions.bufferBytes),
+                             minRingBytes, maxRingBytes);
+    }
+    overflow.store(newOptions.overflow, std::memory_order_relaxed);
+    {
+      auto lock = std::lock_guard(wakeMutex);
+      pollInterval = newOptions.pollInterval;
+      stopping = false;
+    }
+    if (!drainer.joinable()) {
+      drainer = std::thread([this] { run(); });
+    }
+    asyncDebugActive.store(true, std::memory_order_release);
+  }
+
+  void disable() {
+    auto control = std::lock_guard(controlMutex);
+    asyncDebugActive.store(false, std::memory_order_release);
+    if (drainer.joinable()) {
+      {
+        auto lock = std::lock_guard(wakeMutex);
+        stopping = true;
+      }
+      wake.notify_all();
+      drainer.join();
+    }
+    drainAll();
+  }
+
+  auto threadRing() -> Ring & {
+    thread_local auto handle = RingHandle(*this);
+    return *handle.ring;
+  }
+
+  auto policy() const -> OverflowPolicy {
+    return overflow.load(std::memory_order_relaxed);
+  }
+
+  auto droppedMessages() -> std::uint64_t {
+    auto lock = std::lock_guard(registryMutex);
+    auto total = retiredDropped;
+    for (const auto &ring : rings) {
+      total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   * @brief Format and write everything published so far, in one batch.
+   */
+  auto drainAll() -> bool {
+    // Formatting runs user code. If that fails an assertion, reporting it
+    // flushes the buffers again, which must not wait for this drain.
+    if (draining) {
+      return false;
+    }
+    auto drainLock = std::lock_guard(drainMutex);
+    draining = true;
+    try {
+      bool any = drainLocked();
+      draining = false;
+      return any;
+    } catch (...) {
+      draining = false;
+      throw;
+    }
+  }
+
+private:
+  auto drainLocked() -> bool {
+    auto snapshot = std::vector<std::shared_ptr<Ring>>();
+    {
+      auto lock = std::lock_guard(registryMutex);
+      snapshot = rings;
+    }
+
+    auto batch = DecodedRecords();
+    bool any = false;
+    for (const auto &ring : snapshot) {
+      any |= ring->drain([&](const std::byte *record,
+                             const RecordHeader &header) {
+        batch.add(record, header, Entry());
+      });
+    }
+    if (any) {
+      emit(batch.entries());
+    }
+
+    auto lock = std::lock_guard(registryMutex);
+    std::erase_if(rings, [&](const std::shared_ptr<Ring> &ring) {
+      bool retired =
+          ring->closed.load(std::memory_order_acquire) && ring->empty();
+      if (retired) {
+        retiredDropped += ring->dropped.load(std::memory_order_relaxed);
+      }
+      return retired;
+    });
+    return any;
+  }
+
+  /// Owned by each producing thread; retires its ring when the thread ends.
+  struct RingHandle {
+    explicit RingHandle(AsyncDebug &owner) {
+      auto lock = std::lock_guard(owner.registryMutex);
+      ring = std::make_shared<Ring>(owner.ringBytes);
+      owner.rings.push_back(ring);
+    }
+    RingHandle(const RingHandle &) = delete;
+    RingHandle(RingHandle &&) = delete;
+    auto operator=(const RingHandle &) -> RingHandle & = delete;
+    auto operator=(RingHandle &&) -> RingHandle & = delete;
+    ~RingHandle() { ring->closed.store(true, std::memory_order_release); }
+
+    std::shared_ptr<Ring> ring;
+  };
+
+  void run() {
+    while (true) {
+      if (drainAll()) {
+        continue;
+      }
+      auto lock = std::unique_lock(wakeMutex);
+      if (wake.wait_for(lock, pollInterval, [&] { return stopping; })) {
+        return;
+      }
+    }
+  }
+
+  std::mutex controlMutex;
+  std::mutex drainMutex;
+
+  std::mutex registryMutex;
+  std::vector<std::shared_ptr<Ring>> rings;
+  std::size_t ringBytes = AsyncDebugOptions().bufferBytes;
+  std::uint64_t retiredDropped = 0;
+
+  std::atomic<OverflowPolicy> overflow = OverflowPolicy::drop;
+
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  std::chrono::microseconds pollInterval{};
+  bool stopping = false;
+  std::thread drainer;
+
+  /// Whether this thread is draining, in drainAll().
+  static thread_local bool draining;
+};
+
+thread_local bool AsyncDebug::draining = false;
+
+auto asyncDebug() -> AsyncDebug & {
+  static auto instance = AsyncDebug();
+  return instance;
+}
+
+} // namespace
+
+void DecodedRecords::add(const std::byte *record, const RecordHeader &header,
+                         Entry entry) {
+  auto first = values.size();
+  const std::byte *cursor = record + sizeof(RecordHeader);
+  for (std::uint32_t i = 0; i < header.argumentCount; ++i) {
+    auto argument = ArgumentHeader();
+    std::memcpy(&argument, cursor, sizeof(argument));
+    arena.beginValue();
+    auto value = Writer(arena);
+    argument.decoder(value, cursor + sizeof(argument), argument.size);
+    value.finish();
+    values.push_back(arena.endValue());
+    cursor += sizeof(argument) + alignRecord(argument.size);
+  }
+  const auto &site = *header.site;
+  entry.file = site.file;
+  entry.line = site.line;
+  entry.expressions = site.expressions;
+  decoded.push_back(entry);
+  valueRanges.emplace_back(first, header.argumentCount);
+}
+
+auto DecodedRecords::entries() -> std::span<const Entry> {
+  // Values are only pointed to now, as adding more may have moved them.
+  for (std::size_t i = 0; i < decoded.size(); ++i) {
+    auto [first, count] = valueRanges[i];
+    decoded[i].values = std::span(values).subspan(first, count);
+  }
+  return decoded;
+}
+
+auto reserveDebugRecord(std::size_t size) -> std::byte * {
+  auto &async = asyncDebug();
+  return async.threadRing().reserve(size, async.policy());
+}
+
+void commitDebugRecord(std::size_t size) {
+  asyncDebug().threadRing().commit(size);
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void enableAsyncDebug(const AsyncDebugOptions &options) {
+  internal::asyncDebug().enable(options);
+}
+
+void disableAsyncDebug() { internal::asyncDebug().disable(); }
+
+void flushAsyncDebug() { internal::asyncDebug().drainAll(); }
+
+auto droppedDebugMessages() -> std::uint64_t {
+  return internal::asyncDebug().droppedMessages();
+}
+
+} // namespace errantibus
@@ -0,0 +1,229 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/checks.hpp"
+#include "report.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace errantibus::internal {
+
+namespace {
+
+constexpr auto defaults = CheckOptions();
+
+constinit std::atomic<CheckHandler> handler = defaults.handler;
+constinit std::atomic<std::uint32_t> fullReports = defaults.fullReports;
+constinit std::atomic<std::int64_t> summaryInterval =
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        defaults.summaryInterval)
+        .count();
+
+/// Every site that has failed, most recent first.
+constinit std::atomic<CheckSite *> failedSites = nullptr;
+
+auto now() -> std::int64_t {
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+void summarizeAtExit();
+
+void listSite(CheckSite &site) {
+  // Registered when the first check fails.
+  [[maybe_unused]] static const bool atExit =
+      std::atexit(&summarizeAtExit) == 0;
+  auto *head = failedSites.load(std::memory_order_relaxed);
+  do {
+    site.next = head;
+  } while (!failedSites.compare_exchange_weak(head, &site,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+}
+
+/// Raise `counter` to at least `value`.
+void raiseTo(std::atomic<std::uint64_t> &counter, std::uint64_t value) {
+  auto current = counter.load(std::memory_order_relaxed);
+  while (current < value &&
+         !counter.compare_exchange_weak(current, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+auto failureOf(const CheckSite &site, std::string_view message,
+               std::uint64_t number) -> CheckFailure {
+  return {site.file, site.line, site.condition, message, nullptr, number, 0};
+}
+
+/**
+ * @brief Pass the failures of `site` that went unreported since its last
+ * report to the handler, as a summary without message. Unless `force` is
+ * set, only once the summary interval has passed since that report.
+ */
+void summarize(CheckSite &site, bool force) {
+  auto failures = site.failures.load(std::memory_order_relaxed);
+  if (failures <= site.reported.load(std::memory_order_relaxed)) {
+    return;
+  }
+  auto time = now();
+  auto last = site.lastReport.load(std::memory_order_relaxed);
+  if ((!force &&
+       time - last < summaryInterval.load(std::memory_order_relaxed)) ||
+      !site.lastReport.compare_exchange_strong(last, time,
+                                               std::memory_order_relaxed)) {
+    return;
+  }
+  auto reported = site.reported.exchange(failures, std::memory_order_relaxed);
+  if (reported >= failures) {
+    return;
+  }
+  auto failure = failureOf(site, {}, failures);
+  failure.unreported = failures - reported;
+  handler.load(std::memory_order_relaxed)(failure);
+}
+
+void summarizeAtExit() {
+  try {
+    flushCheckSummaries();
+  } catch (...) {
+    // A throwing handler has nobody to throw to at exit.
+  }
+}
+
+} // namespace
+
+auto beginCheckFailure(CheckSite &site, std::string_view message)
+    -> std::uint64_t {
+  auto number = site.failures.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (number == 1) {
+    listSite(site);
+  }
+  auto time = now();
+  if (number <= fullReports.load(std::memory_order_relaxed)) {
+    site.lastReport.store(time, std::memory_order_relaxed);
+    raiseTo(site.reported, number);
+    return number;
+  }
+  auto failure = failureOf(site, message, number);
+  // Of the threads that find a summary due, the one that moves the time of
+  // the last report forward writes it.
+  auto last = site.lastReport.load(std::memory_order_relaxed);
+  if (time - last >= summaryInterval.load(std::memory_order_relaxed) &&
+      site.lastReport.compare_exchange_strong(last, time,
+                                              std::memory_order_relaxed)) {
+    auto reported = site.reported.exchange(number, std::memory_order_relaxed);
+    failure.unreported = number - std::min(reported, number);
+  }
+  handler.load(std::memory_order_relaxed)(failure);
+  return 0;
+}
+
+void endCheckFailure(CheckSite &site, std::string_view message,
+                     std::uint64_t number, Entry entry) {
+  entry.failures = number;
+  if (number == fullReports.load(std::memory_order_relaxed)) {
+    entry.note = "Further failures of this check are only counted.";
+  }
+  auto failure = failureOf(site, message, number);
+  failure.entry = &entry;
+  handler.load(std::memory_order_relaxed)(failure);
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void logCheckFailure(const CheckFailure &failure) {
+  if (failure.entry != nullptr) {
+    internal::emit(*failure.entry);
+  } else if (failure.unreported != 0) {
+    internal::emit(Entry{.kind = EntryKind::summary,
+                         .file = failure.file,
+                         .line = failure.line,
+                         .message = failure.message,
+                         .thread = static_cast<std::uint64_t>(::gettid()),
+                         .condition = failure.condition,
+                         .failures = failure.failures,
+                         .unreported = failure.unreported});
+  }
+}
+
+void throwCheckFailure(const CheckFailure &failure) {
+  throw CheckError(failure);
+}
+
+void countCheckFailure([[maybe_unused]] const CheckFailure &failure) {}
+
+namespace {
+
+auto describe(const CheckFailure &failure) -> std::string {
+  if (failure.entry != nullptr) {
+    // The position and message first, the stack trace after the values.
+    auto details = *failure.entry;
+    details.frames = {};
+    auto text = std::string();
+    encodeText(text, std::span(&details, 1), false);
+    if (!failure.entry->frames.empty()) {
+      while (text.ends_with("\n\n")) {
+        text.pop_back();
+      }
+      auto out = internal::StringWriter(text);
+      internal::writeFrames(out, failure.entry->frames, false);
+    }
+    return text;
+  }
+  auto text = std::string(failure.file);
+  text += ':';
+  text += std::to_string(failure.line);
+  if (!failure.message.empty()) {
+    text += " - ";
+    text += failure.message;
+  }
+  return text;
+}
+
+} // namespace
+
+CheckError::CheckError(const CheckFailure &failure) :
+    std::runtime_error(describe(failure)) {}
+
+void setCheckOptions(const CheckOptions &options) {
+  internal::handler.store(options.handler != nullptr ? options.handler
+                                                     : countCheckFailure,
+                          std::memory_order_relaxed);
+  internal::fullReports.store(options.fullReports,
+                              std::memory_order_relaxed);
+  internal::summaryInterval.store(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          options.summaryInterval)
+          .count(),
+      std::memory_order_relaxed);
+}
+
+void flushCheckSummaries() {
+  for (auto *site = internal::failedSites.load(std::memory_order_acquire);
+       site != nullptr; site = site->next) {
+    internal::summarize(*site, true);
+  }
+}
+
+auto checkStatistics() -> std::vector<CheckStatistics> {
+  auto result = std::vector<CheckStatistics>();
+  for (auto *site = internal::failedSites.load(std::memory_order_acquire);
+       site != nullptr; site = site->next) {
+    internal::summarize(*site, false);
+    result.push_back({site->file, site->line, site->condition,
+                      site->failures.load(std::memory_order_relaxed)});
+  }
+  std::ranges::stable_sort(result, [](const auto &a, const auto &b) {
+    return a.failures > b.failures;
+  });
+  return result;
+}
+
+} // namespace errantibus
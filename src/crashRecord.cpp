@@ -0,0 +1,290 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "crashRecord.hpp"
+#include "emergency.hpp"
+#include "errantibus/crashRecord.hpp"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+namespace errantibus::internal {
+
+namespace {
+
+constexpr std::string_view magic = "ERRCRSH1";
+constexpr const char *environmentVariable = "ERRANTIBUS_CRASH_RECORD";
+
+std::mutex pathMutex;
+std::optional<std::string> configuredPath;
+bool configured = false;
+
+auto executablePath() -> std::string {
+  auto buffer = std::array<char, 4096>();
+  auto length = readlink("/proc/self/exe", buffer.data(), buffer.size() - 1);
+  return length > 0 ? std::string(buffer.data(), length) : std::string();
+}
+
+/**
+ * @brief Find the GNU build-id note among `size` bytes of ELF notes.
+ */
+auto findBuildId(const char *notes, std::size_t size) -> std::string {
+  std::size_t offset = 0;
+  while (offset + sizeof(ElfW(Nhdr)) <= size) {
+    auto header = ElfW(Nhdr)();
+    std::memcpy(&header, notes + offset, sizeof(header));
+    auto nameOffset = offset + sizeof(header);
+    auto descOffset = nameOffset + ((header.n_namesz + 3) & ~3U);
+    auto next = descOffset + ((header.n_descsz + 3) & ~3U);
+    if (next > size) {
+      break;
+    }
+    if (header.n_type == NT_GNU_BUILD_ID && header.n_namesz == 4 &&
+        std::memcmp(notes + nameOffset, "GNU", 4) == 0) {
+      return {notes + descOffset, header.n_descsz};
+    }
+    offset = next;
+  }
+  return {};
+}
+
+void appendInt(std::string &out, std::uint64_t value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void appendString(std::string &out, std::string_view text) {
+  appendInt(out, text.size());
+  out.append(text);
+}
+
+/**
+ * @brief Reads back what appendInt and appendString wrote. Once it runs out
+ * of data, it stays failed.
+ */
+class Reader {
+public:
+  explicit Reader(std::string_view data) : data(data) {}
+
+  auto readInt() -> std::uint64_t {
+    auto value = std::uint64_t{0};
+    if (data.size() < sizeof(value)) {
+      failed = true;
+      return 0;
+    }
+    std::memcpy(&value, data.data(), sizeof(value));
+    data.remove_prefix(sizeof(value));
+    return value;
+  }
+
+  auto readString() -> std::string {
+    auto size = readInt();
+    if (size > data.size()) {
+      failed = true;
+      return {};
+    }
+    auto text = std::string(data.substr(0, size));
+    data.remove_prefix(size);
+    return text;
+  }
+
+  /// Element counts are checked against the remaining data, so that a
+  /// corrupt record cannot make us allocate huge vectors.
+  auto readCount(std::size_t minElementSize) -> std::size_t {
+    auto count = readInt();
+    if (count > data.size() / minElementSize) {
+      failed = true;
+      return 0;
+    }
+    return count;
+  }
+
+  auto ok() const -> bool { return !failed; }
+
+private:
+  std::string_view data;
+  bool failed = false;
+};
+
+} // namespace
+
+auto crashRecordPath() -> std::optional<std::string> {
+  auto lock = std::lock_guard(pathMutex);
+  auto path = configuredPath;
+  if (!configured) {
+    if (const char *variable = std::getenv(environmentVariable)) {
+      path = variable;
+    }
+  }
+  if (!path || path->empty()) {
+    return std::nullopt;
+  }
+  if (auto pid = path->find("%p"); pid != std::string::npos) {
+    path->replace(pid, 2, std::to_string(getpid()));
+  }
+  return path;
+}
+
+auto loadedModules() -> std::vector<CrashModule> {
+  auto modules = std::vector<CrashModule>();
+  dl_iterate_phdr(
+      [](dl_phdr_info *info, std::size_t, void *data) -> int {
+        auto &modules = *static_cast<std::vector<CrashModule> *>(data);
+        auto module = CrashModule();
+        const char *name = info->dlpi_name;
+        module.path =
+            (name == nullptr || *name == '\0') ? executablePath() : name;
+        module.bias = info->dlpi_addr;
+        module.start = UINT64_MAX;
+        for (int i = 0; i < info->dlpi_phnum; ++i) {
+          const auto &header = info->dlpi_phdr[i];
+          auto start = info->dlpi_addr + header.p_vaddr;
+          if (header.p_type == PT_LOAD) {
+            module.start = std::min<std::uint64_t>(module.start, start);
+            module.end =
+                std::max<std::uint64_t>(module.end, start + header.p_memsz);
+          } else if (header.p_type == PT_NOTE && module.buildId.empty()) {
+            module.buildId = findBuildId(reinterpret_cast<const char *>(start),
+                                         header.p_memsz);
+          }
+        }
+        if (module.end != 0) {
+          modules.push_back(std::move(module));
+        }
+        return 0;
+      },
+      &modules);
+  return modules;
+}
+
+auto encodeCrashRecord(const CrashRecord &record) -> std::string {
+  auto out = std::string(magic);
+  appendInt(out, record.frames.size());
+  for (auto frame : record.frames) {
+    appendInt(out, frame);
+  }
+  appendInt(out, record.modules.size());
+  for (const auto &module : record.modules) {
+    appendString(out, module.path);
+    appendString(out, module.buildId);
+    appendInt(out, module.bias);
+    appendInt(out, module.start);
+    appendInt(out, module.end);
+  }
+  appendString(out, record.report);
+  return out;
+}
+
+auto decodeCrashRecord(std::string_view data) -> std::optional<CrashRecord> {
+  if (!data.starts_with(magic)) {
+    return std::nullopt;
+  }
+  auto in = Reader(data.substr(magic.size()));
+  auto record = CrashRecord();
+  record.frames.resize(in.readCount(sizeof(std::uint64_t)));
+  for (auto &frame : record.frames) {
+    frame = in.readInt();
+  }
+  record.modules.resize(in.readCount(5 * sizeof(std::uint64_t)));
+  for (auto &module : record.modules) {
+    module.path = in.readString();
+    module.buildId = in.readString();
+    module.bias = in.readInt();
+    module.start = in.readInt();
+    module.end = in.readInt();
+  }
+  record.report = in.readString();
+  if (!in.ok()) {
+    return std::nullopt;
+  }
+  return record;
+}
+
+auto writeFile(const std::string &path, std::string_view data) -> bool {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool written = writeAll(fd, data);
+  return ::close(fd) == 0 && written;
+}
+
+auto findCrashModule(std::span<const CrashModule> modules,
+                     std::uint64_t address) -> const CrashModule * {
+  for (const auto &module : modules) {
+    if (address >= module.start && address < module.end) {
+      return &module;
+    }
+  }
+  return nullptr;
+}
+
+auto hexBuildId(std::string_view buildId) -> std::string {
+  constexpr std::string_view digits = "0123456789abcdef";
+  auto hex = std::string();
+  for (unsigned char byte : buildId) {
+    hex += digits[byte >> 4];
+    hex += digits[byte & 0xf];
+  }
+  return hex;
+}
+
+auto readBuildId(const std::string &path) -> std::string {
+  auto file = std::ifstream(path, std::ios::binary);
+  auto header = ElfW(Ehdr)();
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+      header.e_phentsize != sizeof(ElfW(Phdr))) {
+    return {};
+  }
+  auto programHeaders = std::vector<ElfW(Phdr)>(header.e_phnum);
+  file.seekg(static_cast<std::streamoff>(header.e_phoff));
+  if (!file.read(reinterpret_cast<char *>(programHeaders.data()),
+                 static_cast<std::streamsize>(programHeaders.size() *
+                                              sizeof(ElfW(Phdr))))) {
+    return {};
+  }
+  for (const auto &programHeader : programHeaders) {
+    if (programHeader.p_type != PT_NOTE) {
+      continue;
+    }
+    auto notes = std::string(programHeader.p_filesz, '\0');
+    file.seekg(static_cast<std::streamoff>(programHeader.p_offset));
+    if (!file.read(notes.data(), static_cast<std::streamsize>(notes.size()))) {
+      return {};
+    }
+    if (auto buildId = findBuildId(notes.data(), notes.size());
+        !buildId.empty()) {
+      return buildId;
+    }
+  }
+  return {};
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void enableCrashRecords(const std::string &path) {
+  auto lock = std::lock_guard(internal::pathMutex);
+  internal::configuredPath = path;
+  internal::configured = true;
+}
+
+void disableCrashRecords() {
+  auto lock = std::lock_guard(internal::pathMutex);
+  internal::configuredPath.reset();
+  internal::configured = true;
+}
+
+} // namespace errantibus
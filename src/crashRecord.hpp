@@ -0,0 +1,79 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_CRASH_RECORD_INTERNAL_HPP
+#define ERRANTIBUS_CRASH_RECORD_INTERNAL_HPP
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace errantibus::internal {
+
+/**
+ * @brief A loaded ELF object, as far as needed to symbolize addresses in it
+ * later: where it was mapped and which build it was.
+ */
+struct CrashModule {
+  std::string path;
+  std::string buildId;
+  std::uint64_t bias = 0;
+  std::uint64_t start = 0;
+  std::uint64_t end = 0;
+};
+
+/**
+ * @brief Everything a failure report needs, captured without symbolizing.
+ * `frames` holds return addresses, innermost first, and `report` the text
+ * printed after the stack trace.
+ */
+struct CrashRecord {
+  std::vector<std::uint64_t> frames;
+  std::vector<CrashModule> modules;
+  std::string report;
+};
+
+/**
+ * @brief The path crash records go to, or nothing if they are off.
+ */
+auto crashRecordPath() -> std::optional<std::string>;
+
+/**
+ * @brief All objects loaded into the process right now.
+ */
+auto loadedModules() -> std::vector<CrashModule>;
+
+auto encodeCrashRecord(const CrashRecord &record) -> std::string;
+
+auto decodeCrashRecord(std::string_view data) -> std::optional<CrashRecord>;
+
+/**
+ * @brief Write `data` to a new file at `path`, in as few system calls as
+ * possible.
+ */
+auto writeFile(const std::string &path, std::string_view data) -> bool;
+
+/**
+ * @brief The module that contains `address`, if any.
+ */
+auto findCrashModule(std::span<const CrashModule> modules,
+                     std::uint64_t address) -> const CrashModule *;
+
+/**
+ * @brief Hex encoding of a build-id, as used in `.build-id` directories.
+ */
+auto hexBuildId(std::string_view buildId) -> std::string;
+
+/**
+ * @brief The build-id stored in the ELF file at `path`, or an empty string.
+ */
+auto readBuildId(const std::string &path) -> std::string;
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_CRASH_RECORD_INTERNAL_HPP
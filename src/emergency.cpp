@@ -0,0 +1,274 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "emergency.hpp"
+#include "errantibus/signalHandlers.hpp"
+
+#include <boost/stacktrace/safe_dump_to.hpp>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace errantibus::internal {
+
+namespace {
+
+constexpr int reportFd = STDERR_FILENO;
+constexpr std::size_t arenaSize = std::size_t{64} << 10;
+constexpr std::size_t signalStackSize = std::size_t{64} << 10;
+constexpr std::size_t pageSize = 4096;
+constexpr std::size_t maxFrames = 128;
+
+constexpr std::string_view yellow = "\033[33m";
+constexpr std::string_view red = "\033[31m";
+constexpr std::string_view bold = "\033[1m";
+constexpr std::string_view reset = "\033[0m";
+
+constexpr std::array handledSignals = {SIGSEGV, SIGBUS, SIGILL, SIGFPE,
+                                       SIGABRT};
+
+/// Emergency reports are formatted here, so that a report of up to this
+/// size goes out in one write.
+alignas(pageSize) char arena[arenaSize];
+std::atomic_flag arenaTaken;
+
+alignas(16) char signalStack[signalStackSize];
+std::array<struct sigaction, NSIG> previousActions;
+std::atomic<bool> handlersInstalled = false;
+
+std::atomic<bool> firstFailureClaimed = false;
+std::atomic<const PendingReport *> pendingReport = nullptr;
+/// Set once a report is out, so that the SIGABRT of terminating after it
+/// is not reported again.
+std::atomic<bool> reportFinished = false;
+thread_local bool reporting = false;
+
+/// The pages of the arena are touched at startup, so that they are
+/// already there when memory runs out.
+[[maybe_unused]] const bool arenaCommitted = [] {
+  for (std::size_t i = 0; i < arenaSize; i += pageSize) {
+    static_cast<volatile char &>(arena[i]) = 0;
+  }
+  return true;
+}();
+
+template <typename Write>
+void writeEmergency(const Write &write) {
+  // A second thread failing at the same time gets a smaller buffer.
+  std::array<char, 512> fallback; // NOLINT: not initialized on purpose
+  bool ownsArena = !arenaTaken.test_and_set(std::memory_order_acquire);
+  {
+    auto out = RawWriter(reportFd, ownsArena ? std::span<char>(arena)
+                                             : std::span<char>(fallback));
+    write(out);
+  }
+  if (ownsArena) {
+    arenaTaken.clear(std::memory_order_release);
+  }
+}
+
+/**
+ * @brief Copy the executable mappings from /proc/self/maps, which are
+ * needed to symbolize the raw addresses by hand.
+ */
+void writeExecutableMappings(RawWriter &out) {
+  int fd = ::open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  out << "Executable mappings:\n";
+  std::array<char, 1024> chunk; // NOLINT
+  std::array<char, 512> line;   // NOLINT
+  std::size_t length = 0;
+  while (true) {
+    auto count = ::read(fd, chunk.data(), chunk.size());
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    for (char c : std::span(chunk.data(), static_cast<std::size_t>(count))) {
+      if (c != '\n') {
+        if (length < line.size()) {
+          line[length++] = c;
+        }
+        continue;
+      }
+      // Lines look like `start-end perms offset device inode path`.
+      auto text = std::string_view(line.data(), length);
+      auto space = text.find(' ');
+      if (space != std::string_view::npos && space + 3 < text.size() &&
+          text[space + 3] == 'x') {
+        out << '\t' << text << '\n';
+      }
+      length = 0;
+    }
+  }
+  ::close(fd);
+}
+
+[[gnu::noinline]] void writeRawTrace(RawWriter &out) {
+  std::array<void *, maxFrames> frames; // NOLINT
+  // Skip writeRawTrace itself and the function that dumps the frames.
+  auto count =
+      boost::stacktrace::safe_dump_to(2, frames.data(), sizeof(frames));
+  out << '\n';
+  out << yellow << bold << "Stacktrace (not symbolized, most recent call last):"
+      << reset << '\n';
+  for (auto i = count; i-- > 0;) {
+    if (frames[i] != nullptr) {
+      out << " #" << i << ' ' << frames[i] << '\n';
+    }
+  }
+  writeExecutableMappings(out);
+  out << '\n';
+}
+
+auto signalName(int signal) -> const char * {
+  switch (signal) {
+  case SIGSEGV:
+    return "SIGSEGV (invalid memory access)";
+  case SIGBUS:
+    return "SIGBUS (bus error)";
+  case SIGILL:
+    return "SIGILL (illegal instruction)";
+  case SIGFPE:
+    return "SIGFPE (arithmetic error)";
+  case SIGABRT:
+    return "SIGABRT (aborted)";
+  default:
+    return "unknown signal";
+  }
+}
+
+void handleSignal(int signal, siginfo_t *info, void *) {
+  auto savedErrno = errno;
+  // Faults while reporting go straight to the previous handler.
+  ::sigaction(signal, &previousActions[signal], nullptr);
+  if (!reportFinished.exchange(true)) {
+    writeEmergency([&](RawWriter &out) {
+      writeRawTrace(out);
+      out << red << bold << "Fatal signal " << signalName(signal);
+      if (signal != SIGABRT) {
+        out << " at address " << info->si_addr;
+      }
+      out << reset << '\n';
+      if (const auto *report = pendingReport.load()) {
+        out << "while reporting:\n";
+        report->write(report->context, out);
+      }
+    });
+  }
+  errno = savedErrno;
+  // A fault from the hardware happens again when the handler returns, this
+  // time in the previous handler. Sent signals have to be sent again.
+  if (signal == SIGABRT || info->si_code <= 0) {
+    ::raise(signal);
+  }
+}
+
+} // namespace
+
+auto RawWriter::operator<<(std::string_view text) -> RawWriter & {
+  while (!text.empty()) {
+    if (used == buffer.size()) {
+      flush();
+    }
+    auto count = std::min(text.size(), buffer.size() - used);
+    std::memcpy(buffer.data() + used, text.data(), count);
+    used += count;
+    text.remove_prefix(count);
+  }
+  return *this;
+}
+
+auto RawWriter::operator<<(const void *address) -> RawWriter & {
+  char digits[2 * sizeof(std::uintptr_t)];
+  auto [end, ec] =
+      std::to_chars(digits, digits + sizeof(digits),
+                    reinterpret_cast<std::uintptr_t>(address), 16);
+  return *this << "0x" << std::string_view(digits, end - digits);
+}
+
+void RawWriter::flush() {
+  writeAll(fd, std::string_view(buffer.data(), used));
+  used = 0;
+}
+
+auto writeAll(int fd, std::string_view data) -> bool {
+  while (!data.empty()) {
+    auto written = ::write(fd, data.data(), data.size());
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+
+auto beginReport(const PendingReport &report) -> ReportRole {
+  if (reporting) {
+    return ReportRole::nested;
+  }
+  reporting = true;
+  if (firstFailureClaimed.exchange(true)) {
+    return ReportRole::follower;
+  }
+  pendingReport.store(&report);
+  return ReportRole::first;
+}
+
+void endReport(const PendingReport &report) {
+  reportFinished.store(true);
+  const auto *expected = &report;
+  pendingReport.compare_exchange_strong(expected, nullptr);
+}
+
+[[noreturn]] void emergencyFailure(std::string_view reason,
+                                   const PendingReport &report) {
+  reportFinished.store(true);
+  writeEmergency([&](RawWriter &out) {
+    writeRawTrace(out);
+    out << yellow << reason << reset << '\n';
+    report.write(report.context, out);
+  });
+  std::abort();
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void installSignalHandlers() {
+  if (internal::handlersInstalled.exchange(true)) {
+    return;
+  }
+  auto stack = stack_t();
+  stack.ss_sp = internal::signalStack;
+  stack.ss_size = internal::signalStackSize;
+  ::sigaltstack(&stack, nullptr);
+  for (int signal : internal::handledSignals) {
+    struct sigaction action {};
+    action.sa_sigaction = internal::handleSignal;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(signal, &action, &internal::previousActions[signal]);
+  }
+}
+
+} // namespace errantibus
@@ -0,0 +1,113 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_EMERGENCY_HPP
+#define ERRANTIBUS_EMERGENCY_HPP
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace errantibus::internal {
+
+/**
+ * @brief Report output that neither allocates nor takes locks, so that it
+ * works after heap corruption, without memory and inside signal handlers.
+ * Text is collected in a fixed buffer and written to `fd` with write(2)
+ * whenever the buffer is full, and when the writer is destroyed.
+ */
+class RawWriter {
+public:
+  explicit RawWriter(int fd, std::span<char> buffer) :
+      fd(fd), buffer(buffer) {}
+  RawWriter(const RawWriter &) = delete;
+  RawWriter(RawWriter &&) = delete;
+  auto operator=(const RawWriter &) -> RawWriter & = delete;
+  auto operator=(RawWriter &&) -> RawWriter & = delete;
+  ~RawWriter() { flush(); }
+
+  auto operator<<(std::string_view text) -> RawWriter &;
+
+  auto operator<<(const char *text) -> RawWriter & {
+    return *this << std::string_view(text);
+  }
+
+  auto operator<<(char c) -> RawWriter & {
+    return *this << std::string_view(&c, 1);
+  }
+
+  template <std::integral T>
+  auto operator<<(T value) -> RawWriter & {
+    char digits[24];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    return *this << std::string_view(digits, end - digits);
+  }
+
+  /// Addresses are written in hex, as `0x...`.
+  auto operator<<(const void *address) -> RawWriter &;
+
+  void flush();
+
+private:
+  int fd;
+  std::span<char> buffer;
+  std::size_t used = 0;
+};
+
+/**
+ * @brief Write all of `data` to `fd`, retrying short and interrupted
+ * writes. Returns false if the data could not be written.
+ */
+auto writeAll(int fd, std::string_view data) -> bool;
+
+/**
+ * @brief A failure report that is being written. Its text can be written
+ * again through a RawWriter, should the normal report crash or run out of
+ * memory on the way.
+ */
+struct PendingReport {
+  template <typename WriteReport>
+  explicit PendingReport(const WriteReport &writeReport) :
+      context(&writeReport), write([](const void *context, RawWriter &out) {
+        (*static_cast<const WriteReport *>(context))(out);
+      }) {}
+
+  const void *context;
+  void (*write)(const void *context, RawWriter &out);
+};
+
+enum class ReportRole {
+  /// The first failure of the process, which gets the full report.
+  first,
+  /// A failure while another thread is reporting the first one.
+  follower,
+  /// A failure while this thread is still writing a report, i.e. the report
+  /// itself failed, so it must not take the normal path again.
+  nested,
+};
+
+/**
+ * @brief Announce the report that is about to be written. Only the first
+ * failure of the process is reported in full.
+ */
+auto beginReport(const PendingReport &report) -> ReportRole;
+
+/**
+ * @brief Mark the report as written; later signals come from terminating.
+ */
+void endReport(const PendingReport &report);
+
+/**
+ * @brief Write `report` through the emergency path, with the raw return
+ * addresses of the current stack instead of a symbolized trace, and abort.
+ */
+[[noreturn]] void emergencyFailure(std::string_view reason,
+                                   const PendingReport &report);
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_EMERGENCY_HPP
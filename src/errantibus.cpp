@@ -4,19 +4,24 @@
  */
 
 #include "mode/errantibusDebug.hpp"
-#include "mode/errantibusNoDebug.hpp"
+#include "errantibus/flightRecorder.hpp"
+#include "errantibus/stackCapture.hpp"
+#include "crashRecord.hpp"
+#include "emergency.hpp"
+#include "report.hpp"
+#include "symbolizer.hpp"
 
-#include <boost/stacktrace/stacktrace.hpp>
+#include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
-#include <fstream>
-#include <ios>
-#include <iostream>
-#include <iterator>
 #include <limits>
-#include <sstream>
+#include <optional>
+#include <new>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -32,250 +37,471 @@ constexpr std::array specialChars = {
 
 constexpr unsigned del = 0x7f;
 
-void writeChar(std::ostringstream &out, unsigned u, int i, bool isSigned) {
+void writeChar(Writer &out, unsigned u, int i, bool isSigned) {
   if (u < specialChars.size()) {
-    out << '`' << specialChars[u] << '`';
+    out.append('`');
+    out.append(specialChars[u]);
+    out.append('`');
   } else if (u == del) {
-    out << "`DEL`";
+    out.append("`DEL`");
   } else if (u < del) {
-    out << '`' << static_cast<char>(u) << '`';
+    out.append('`');
+    out.append(static_cast<char>(u));
+    out.append('`');
   }
 
+  out.append(" numeric: ");
   if (isSigned) {
-    out << " numeric: " << i << " (signed)";
+    out.appendNumber(i);
+    out.append(" (signed)");
   } else {
-    out << " numeric: " << u << " (unsigned)";
+    out.appendNumber(u);
+    out.append(" (unsigned)");
   }
 }
 
 } // namespace
 
-void stringify(std::ostringstream &out, char obj) {
+void stringify(Writer &out, char obj) {
   writeChar(out, static_cast<unsigned char>(obj), static_cast<int>(obj),
             std::numeric_limits<char>::is_signed);
 }
 
-void stringify(std::ostringstream &out, unsigned char obj) {
+void stringify(Writer &out, unsigned char obj) {
   writeChar(out, obj, static_cast<int>(obj), false);
 }
 
-void stringify(std::ostringstream &out, signed char obj) {
+void stringify(Writer &out, signed char obj) {
   writeChar(out, static_cast<unsigned char>(obj), static_cast<int>(obj), true);
 }
 
-void stringify(std::ostringstream &out, bool obj) {
-  out << (obj ? "`true`" : "`false`");
+void stringify(Writer &out, bool obj) {
+  out.append(obj ? "`true`" : "`false`");
 }
 
 namespace {
 
-constexpr std::string_view yellow = "\033[33m";
-constexpr std::string_view blue = "\033[34m";
-constexpr std::string_view red = "\033[31m";
-constexpr std::string_view bold = "\033[1m";
-constexpr std::string_view reset = "\033[0m";
-
-auto loadSourceContext(const std::string &filename, std::int64_t lineNo,
-                       std::int64_t before, std::int64_t after)
-    -> std::vector<std::string> {
-  auto lines = std::vector<std::string>();
-  lines.reserve(before + 1 + after);
-  auto file = std::ifstream{std::string{filename}};
-  if (!file) {
-    return {};
-  }
+constexpr std::size_t maxFrames = std::size_t{1} << 16;
+/// Frames of the C runtime at the bottom of a complete trace.
+constexpr std::size_t runtimeFrames = 3;
 
-  std::int64_t start = std::max(static_cast<std::int64_t>(1), lineNo - before);
-  std::int64_t end = lineNo + after;
-  for (std::int64_t l = 1; l < start; ++l) {
-    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+/**
+ * @brief Return addresses of the code that failed, without the frames of
+ * the failure handling at the top and of the C runtime at the bottom.
+ */
+[[gnu::noinline]] auto captureFrames() -> std::vector<const void *> {
+  // captureFrames, reportFailure, fail* and the cold thunk
+  constexpr std::size_t skipTop = 4;
+  auto addresses = std::vector<const void *>(256);
+  auto count = unwindStack(addresses, skipTop);
+  while (count == addresses.size() && addresses.size() < maxFrames) {
+    addresses.resize(4 * addresses.size());
+    count = unwindStack(addresses, skipTop);
   }
-  for (std::int64_t l = start; l < end; ++l) {
-    if (!file) {
-      break;
-    }
-    auto line = std::string();
-    std::getline(file, line);
-    lines.push_back(line);
+  // Only a complete trace ends in the C runtime.
+  if (count < addresses.size()) {
+    count = count > runtimeFrames ? count - runtimeFrames : 0;
   }
-  return lines;
+  addresses.resize(count);
+  return addresses;
 }
 
-auto printSourceContext(const std::string &filename, std::size_t lineNo) {
-  std::int64_t before = 2;
-  std::int64_t after = 2;
-  auto loc = static_cast<std::int64_t>(lineNo);
-  auto context = loadSourceContext(filename, loc, before, after);
-  for (std::int64_t i = 0; i < std::ssize(context); ++i) {
-    std::int64_t l = loc - before + i;
-    std::int64_t padding = 10 - std::ssize(toString(l));
-    for (int k = 0; k < padding; ++k) {
-      std::cerr << ' ';
-    }
-    if (i == before) {
-      std::cerr << blue;
-      std::cerr << "> " << l << " |\t";
-    } else {
-      std::cerr << "  " << l << " |\t";
-    }
-    std::cerr << context[i];
-    if (i == before) {
-      std::cerr << reset;
-    }
-    std::cerr << '\n';
+/**
+ * @brief The stack an asynchronous assertion was made on, without the
+ * frames of the C runtime, like captureFrames.
+ */
+auto originFrames(const AsyncOrigin &origin) -> std::vector<const void *> {
+  auto frames = origin.stack.frames();
+  auto count = frames.size();
+  if (count < Backtrace::capacity) {
+    count = count > runtimeFrames ? count - runtimeFrames : 0;
   }
+  return {frames.begin(), frames.begin() + static_cast<std::ptrdiff_t>(count)};
 }
 
-void printStackTrace() {
-  std::cerr << '\n';
-  std::cerr << yellow << bold << "Stacktrace (most recent call last):" << reset
-            << '\n';
-  auto trace = boost::stacktrace::stacktrace();
-  int size = static_cast<int>(trace.size());
-  int skipBottom = 3;
-  int skipTop = 2;
-  for (int i = size - skipBottom - 1; i >= skipTop; --i) {
-    auto frame = trace[i];
-    if (!frame) {
-      continue;
-    }
-    std::cerr << yellow << " #" << i << " " << frame.name() << reset << "\n";
-    std::cerr << '\t' << "at " << frame.source_file() << ':'
-              << frame.source_line() << " at " << frame.address() << '\n';
-    printSourceContext(frame.source_file(), frame.source_line());
-  }
-  std::cerr << '\n';
+auto threadId() -> std::uint64_t {
+  return static_cast<std::uint64_t>(::gettid());
 }
 
-[[noreturn]] void terminate() {
-  std::cerr << '\n';
-  std::terminate();
+/**
+ * @brief Write the crash record, if they are enabled. Returns the path it
+ * was written to, if the failure has been reported that way.
+ */
+auto writeCrashRecord(std::span<const void *const> addresses,
+                      std::span<const Entry> entries)
+    -> std::optional<std::string> {
+  auto path = crashRecordPath();
+  if (!path) {
+    return std::nullopt;
+  }
+  auto record = CrashRecord();
+  for (const auto *address : addresses) {
+    record.frames.push_back(reinterpret_cast<std::uintptr_t>(address));
+  }
+  record.modules = loadedModules();
+  encodeText(record.report, entries, false);
+  if (!writeFile(*path, encodeCrashRecord(record))) {
+    return std::nullopt;
+  }
+  return path;
 }
 
-auto trim(std::string_view sv) -> std::string_view {
-  while (!sv.empty() && std::isspace(static_cast<unsigned char>(sv.front()))) {
-    sv.remove_prefix(1);
+/**
+ * @brief Note a failure that happened while another thread is reporting the
+ * first one, and wait for that thread to terminate the process. The note
+ * goes to the configured output, or as text to stderr if that fails.
+ */
+[[noreturn]] void reportFollower(std::string_view file, std::size_t line,
+                                 std::string_view msg) {
+  try {
+    auto note = "Also failed on thread " + std::to_string(threadId()) +
+                ", not reported.";
+    emit(Entry{.kind = EntryKind::failure,
+               .file = file,
+               .line = line,
+               .message = msg,
+               .thread = threadId(),
+               .note = note});
+  } catch (...) {
+    std::array<char, 512> buffer; // NOLINT: not initialized on purpose
+    auto out = RawWriter(STDERR_FILENO, buffer);
+    writeHeader(out, file, line, msg, ::isatty(STDERR_FILENO) == 1);
+    out << "   Also failed on thread " << ::gettid() << ", not reported.\n";
   }
-  while (!sv.empty() && std::isspace(static_cast<unsigned char>(sv.back()))) {
-    sv.remove_suffix(1);
+  while (true) {
+    ::pause();
   }
-  return sv;
 }
 
-auto splitExpressions(std::string_view input) -> std::vector<std::string_view> {
-  auto result = std::vector<std::string_view>();
-  std::size_t start = 0;
-  std::size_t parenDepth = 0;
-
-  for (size_t i = 0; i < input.size(); ++i) {
-    char c = input[i];
-
-    if (c == '(') {
-      ++parenDepth;
-    } else if (c == ')' && parenDepth > 0) {
-      --parenDepth;
-    } else if (c == ',' && parenDepth == 0) {
-      std::string_view part = input.substr(start, i - start);
-      result.push_back(trim(part));
-      start = i + 1;
-    }
+/**
+ * @brief Report a failure, whose entry `describe` passes to a callback, and
+ * terminate. If the report runs out of memory or fails again while it is
+ * written, the entry is written once more on the emergency path, as text
+ * to stderr.
+ *
+ * The report is assembled completely before it goes out in a single write,
+ * so reports from several threads cannot interleave. Only the first failing
+ * thread reports in full; later ones add a line each and wait.
+ *
+ * A failure found on another thread than where the assertion was made has
+ * its `origin`, whose stack is shown instead of the current one.
+ */
+template <typename Describe>
+[[noreturn, gnu::noinline]] void reportFailure(
+    std::string_view file, std::size_t line, std::string_view msg,
+    const Describe &describe, const AsyncOrigin *origin = nullptr) {
+  auto writeReport = [&](RawWriter &out) {
+    describe([&](Entry entry) {
+      entry.kind = EntryKind::failure;
+      writeEntryText(out, entry, ::isatty(STDERR_FILENO) == 1);
+    });
+  };
+  auto pending = PendingReport(writeReport);
+  switch (beginReport(pending)) {
+  case ReportRole::first:
+    break;
+  case ReportRole::follower:
+    reportFollower(file, line, msg);
+  case ReportRole::nested:
+    emergencyFailure("Failed again while reporting a failure:", pending);
   }
-
-  if (start < input.size()) {
-    result.push_back(trim(input.substr(start)));
+  try {
+    flushAsyncDebug();
+    auto addresses =
+        origin == nullptr ? captureFrames() : originFrames(*origin);
+    auto records = DecodedRecords();
+    collectFlightRecords(records);
+    describe([&](Entry failure) {
+      failure.kind = EntryKind::failure;
+      failure.thread = origin == nullptr ? threadId() : origin->thread;
+      if (origin != nullptr) {
+        failure.note = "Verified on a background thread, after the "
+                       "assertion on this stack.";
+      }
+      auto recorded = records.entries();
+      auto batch = std::vector<Entry>(recorded.begin(), recorded.end());
+      batch.push_back(failure);
+      if (auto path = writeCrashRecord(addresses, batch)) {
+        auto note = "Crash record written to " + *path;
+        batch.back().note = note;
+        emit(batch);
+      } else {
+        auto symbols = Symbolizer::instance().resolve(addresses);
+        auto frames = framesOf(addresses, symbols);
+        batch.back().frames = frames;
+        emit(batch);
+      }
+    });
+  } catch (const std::bad_alloc &) {
+    emergencyFailure("Ran out of memory while reporting:", pending);
+  } catch (...) {
+    emergencyFailure("Could not write the full report:", pending);
   }
-  return result;
+  endReport(pending);
+  std::terminate();
 }
 
-void printHeader(std::string_view file, std::size_t line,
-                 std::string_view msg) {
-  std::cerr << red << bold << file << ":" << line;
-  if (!msg.empty()) {
-    std::cerr << " - " << msg;
-  }
-  std::cerr << reset << "\n";
+/**
+ * @brief Report a failed check, whose entry `describe` passes to a callback,
+ * like reportFailure, and pass it to the check handler instead of
+ * terminating.
+ */
+template <typename Describe>
+[[gnu::noinline]] void reportCheck(CheckSite &site, std::uint64_t number,
+                                   std::string_view msg,
+                                   const Describe &describe) {
+  auto addresses = captureFrames();
+  auto symbols = Symbolizer::instance().resolve(addresses);
+  auto frames = framesOf(addresses, symbols);
+  describe([&](Entry entry) {
+    entry.kind = EntryKind::check;
+    entry.thread = threadId();
+    entry.frames = frames;
+    endCheckFailure(site, msg, number, entry);
+  });
 }
 
-void printValues(std::string_view expressions,
-                 const std::vector<std::string> &values) {
-  auto exprs = splitExpressions(expressions);
-  for (std::size_t i = 0; i < values.size(); ++i) {
-    std::cerr << "\t(" << i << ") " << exprs[i] << " = " << values[i] << "\n";
-  }
+/*
+ * Each kind of failure, as a function to pass to reportFailure or
+ * reportCheck. It passes the failure's entry to the function it is called
+ * with. Everything is captured by value, and only refers to the caller's
+ * strings.
+ */
+
+auto describeAssert(std::string_view message, std::string_view condition,
+                    std::string_view file, std::size_t line,
+                    std::span<const std::string_view> expressions,
+                    std::span<const std::string_view> values) {
+  return [=](const auto &use) {
+    use(Entry{.file = file,
+              .line = line,
+              .message = message,
+              .condition = condition,
+              .expressions = expressions,
+              .values = values});
+  };
 }
 
-void printArguments(std::string_view msg, std::string_view firstExpr,
-                    std::string_view firstValue, std::string_view secondExpr,
-                    std::string_view secondValue) {
-  std::cerr << "   " << msg << '\n';
-  std::cerr << "   Left value:  " << firstExpr << '\n';
-  std::cerr << "           is:  " << firstValue << '\n';
-  std::cerr << "   Right value: " << secondExpr << '\n';
-  std::cerr << "            is: " << secondValue << '\n';
+auto describeCompare(std::string_view message, std::string_view expectation,
+                     std::string_view firstExpr, std::string_view firstValue,
+                     std::string_view secondExpr, std::string_view secondValue,
+                     std::string_view file, std::size_t line,
+                     std::span<const std::string_view> expressions,
+                     std::span<const std::string_view> values) {
+  return [=](const auto &use) {
+    auto operands = std::array{
+        Operand{OperandRole::left, firstExpr, firstValue},
+        Operand{OperandRole::right, secondExpr, secondValue}};
+    use(Entry{.file = file,
+              .line = line,
+              .message = message,
+              .expectation = expectation,
+              .operands = operands,
+              .expressions = expressions,
+              .values = values});
+  };
+}
+
+auto describeNear(std::string_view message, std::string_view firstExpr,
+                  std::string_view firstValue, std::string_view secondExpr,
+                  std::string_view secondValue, std::string_view toleranceExpr,
+                  std::string_view toleranceValue, std::string_view file,
+                  std::size_t line,
+                  std::span<const std::string_view> expressions,
+                  std::span<const std::string_view> values) {
+  return [=](const auto &use) {
+    auto operands = std::array{
+        Operand{OperandRole::left, firstExpr, firstValue},
+        Operand{OperandRole::right, secondExpr, secondValue},
+        Operand{OperandRole::tolerance, toleranceExpr, toleranceValue}};
+    use(Entry{.file = file,
+              .line = line,
+              .message = message,
+              .expectation =
+                  "Should be near each other, but were too far apart:",
+              .operands = operands,
+              .expressions = expressions,
+              .values = values});
+  };
+}
+
+auto describeRange(std::string_view message, std::string_view expectation,
+                   std::string_view rangeExpr, RangeExcerpt excerpt,
+                   std::string_view file, std::size_t line,
+                   std::span<const std::string_view> expressions,
+                   std::span<const std::string_view> values) {
+  return [=](const auto &use) {
+    use(Entry{.file = file,
+              .line = line,
+              .message = message,
+              .expectation = expectation,
+              .range = rangeExpr,
+              .excerpt = excerpt,
+              .expressions = expressions,
+              .values = values});
+  };
 }
 
 } // namespace
 
 void printDebug(std::string_view file, std::size_t line,
-                std::string_view expressions,
-                const std::vector<std::string> &values) {
-  printHeader(file, line, "");
-  printValues(expressions, values);
+                std::span<const std::string_view> expressions,
+                std::span<const std::string_view> values) {
+  emit(Entry{.file = file,
+             .line = line,
+             .thread = threadId(),
+             .expressions = expressions,
+             .values = values});
 }
 
 [[noreturn]] void fail(std::string_view message, std::string_view file,
-                       std::size_t line, std::string_view expressions,
-                       const std::vector<std::string> &values) {
-  printStackTrace();
-  printHeader(file, line, message);
-  printValues(expressions, values);
-  terminate();
+                       std::size_t line,
+                       std::span<const std::string_view> expressions,
+                       std::span<const std::string_view> values) {
+  reportFailure(file, line, message, [&](const auto &use) {
+    use(Entry{.file = file,
+              .line = line,
+              .message = message,
+              .expressions = expressions,
+              .values = values});
+  });
 }
 
 [[noreturn]] void failAssert(std::string_view message,
                              std::string_view condition, std::string_view file,
-                             std::size_t line, std::string_view expressions,
-                             const std::vector<std::string> &values) {
-  printStackTrace();
-  printHeader(file, line, message);
-  std::cerr << "Expected true, but was false: " << condition << '\n';
-  printValues(expressions, values);
-  terminate();
+                             std::size_t line,
+                             std::span<const std::string_view> expressions,
+                             std::span<const std::string_view> values) {
+  reportFailure(file, line, message,
+                describeAssert(message, condition, file, line, expressions,
+                               values));
+}
+
+[[noreturn]] void failCompare(std::string_view message,
+                              std::string_view expectation,
+                              std::string_view firstExpr,
+                              std::string_view firstValue,
+                              std::string_view secondExpr,
+                              std::string_view secondValue,
+                              std::string_view file, std::size_t line,
+                              std::span<const std::string_view> expressions,
+                              std::span<const std::string_view> values) {
+  reportFailure(file, line, message,
+                describeCompare(message, expectation, firstExpr, firstValue,
+                                secondExpr, secondValue, file, line,
+                                expressions, values));
 }
 
-[[noreturn]] void failEq(std::string_view message, std::string_view firstExpr,
-                         std::string_view firstValue,
-                         std::string_view secondExpr,
-                         std::string_view secondValue, std::string_view file,
-                         std::size_t line, std::string_view expressions,
-                         const std::vector<std::string> &values) {
-  printStackTrace();
-  printHeader(file, line, message);
-  printArguments("Should be equal, but was different:", firstExpr, firstValue,
-                 secondExpr, secondValue);
-  printValues(expressions, values);
-  terminate();
+[[noreturn]] void failNear(std::string_view message, std::string_view firstExpr,
+                           std::string_view firstValue,
+                           std::string_view secondExpr,
+                           std::string_view secondValue,
+                           std::string_view toleranceExpr,
+                           std::string_view toleranceValue,
+                           std::string_view file, std::size_t line,
+                           std::span<const std::string_view> expressions,
+                           std::span<const std::string_view> values) {
+  reportFailure(file, line, message,
+                describeNear(message, firstExpr, firstValue, secondExpr,
+                             secondValue, toleranceExpr, toleranceValue, file,
+                             line, expressions, values));
 }
 
-[[noreturn]] void failNeq(std::string_view message, std::string_view firstExpr,
-                          std::string_view firstValue,
-                          std::string_view secondExpr,
-                          std::string_view secondValue, std::string_view file,
-                          std::size_t line, std::string_view expressions,
-                          const std::vector<std::string> &values) {
-  printStackTrace();
-  printHeader(file, line, message);
-  printArguments("Should be different, but was equal:", firstExpr, firstValue,
-                 secondExpr, secondValue);
-  printValues(expressions, values);
-  terminate();
+[[noreturn]] void failRange(std::string_view message,
+                            std::string_view expectation,
+                            std::string_view rangeExpr, RangeExcerpt excerpt,
+                            std::string_view file, std::size_t line,
+                            std::span<const std::string_view> expressions,
+                            std::span<const std::string_view> values) {
+  reportFailure(file, line, message,
+                describeRange(message, expectation, rangeExpr, excerpt, file,
+                              line, expressions, values));
+}
+
+[[noreturn]] void failAsync(std::string_view message,
+                            std::string_view condition, std::string_view file,
+                            std::size_t line, const AsyncOrigin *origin,
+                            std::span<const std::string_view> expressions,
+                            std::span<const std::string_view> values) {
+  reportFailure(file, line, message,
+                describeAssert(message, condition, file, line, expressions,
+                               values),
+                origin);
+}
+
+void reportCheckAssert(CheckSite &site, std::uint64_t number,
+                       std::string_view message, std::string_view condition,
+                       std::string_view file, std::size_t line,
+                       std::span<const std::string_view> expressions,
+                       std::span<const std::string_view> values) {
+  reportCheck(site, number, message,
+              describeAssert(message, condition, file, line, expressions,
+                             values));
+}
+
+void reportCheckCompare(CheckSite &site, std::uint64_t number,
+                        std::string_view message, std::string_view expectation,
+                        std::string_view firstExpr, std::string_view firstValue,
+                        std::string_view secondExpr,
+                        std::string_view secondValue, std::string_view file,
+                        std::size_t line,
+                        std::span<const std::string_view> expressions,
+                        std::span<const std::string_view> values) {
+  reportCheck(site, number, message,
+              describeCompare(message, expectation, firstExpr, firstValue,
+                              secondExpr, secondValue, file, line,
+                              expressions, values));
+}
+
+void reportCheckNear(CheckSite &site, std::uint64_t number,
+                     std::string_view message, std::string_view firstExpr,
+                     std::string_view firstValue, std::string_view secondExpr,
+                     std::string_view secondValue,
+                     std::string_view toleranceExpr,
+                     std::string_view toleranceValue, std::string_view file,
+                     std::size_t line,
+                     std::span<const std::string_view> expressions,
+                     std::span<const std::string_view> values) {
+  reportCheck(site, number, message,
+              describeNear(message, firstExpr, firstValue, secondExpr,
+                           secondValue, toleranceExpr, toleranceValue, file,
+                           line, expressions, values));
+}
+
+void reportCheckRange(CheckSite &site, std::uint64_t number,
+                      std::string_view message, std::string_view expectation,
+                      std::string_view rangeExpr, RangeExcerpt excerpt,
+                      std::string_view file, std::size_t line,
+                      std::span<const std::string_view> expressions,
+                      std::span<const std::string_view> values) {
+  reportCheck(site, number, message,
+              describeRange(message, expectation, rangeExpr, excerpt, file,
+                            line, expressions, values));
 }
 
 [[noreturn]] void failNote(const char *message, const char *file,
                            unsigned line) {
-  printHeader(file, line, message);
-  std::cerr << "Compilerd without debug assertions. Terminating...";
-  terminate();
+  emit(Entry{.kind = EntryKind::failure,
+             .file = file,
+             .line = line,
+             .message = message,
+             .thread = threadId(),
+             .note = "Compiled without debug assertions. Terminating..."});
+  std::terminate();
+}
+
+void noteCheckFailure(CheckSite &site, std::string_view message) {
+  auto number = beginCheckFailure(site, message);
+  if (number == 0) {
+    return;
+  }
+  endCheckFailure(site, message, number,
+                  Entry{.kind = EntryKind::check,
+                        .file = site.file,
+                        .line = site.line,
+                        .message = message,
+                        .thread = threadId(),
+                        .condition = site.condition});
 }
 
 } // namespace errantibus::internal
@@ -0,0 +1,198 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/flightRecorder.hpp"
+#include "errantibus/format.hpp"
+#include "report.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace errantibus::internal {
+
+namespace {
+
+constexpr std::size_t defaultDepth = 64;
+constexpr std::size_t maxDepth = std::size_t{1} << 20;
+
+struct OwnedRing {
+  FlightRing ring;
+  std::unique_ptr<FlightSlot[]> slots;
+  pid_t thread = 0;
+};
+
+/**
+ * @brief A consistent copy of one slot, taken while its owner may still be
+ * recording.
+ */
+struct Event {
+  std::uint64_t sequence = 0;
+  alignas(recordAlignment) std::array<std::byte, sizeof(FlightSlot::record)>
+      record;
+};
+
+auto readSlot(const FlightSlot &slot, Event &event) -> bool {
+  auto before = slot.sequence.load(std::memory_order_acquire);
+  if (before == 0 || before % 2 != 0) {
+    return false;
+  }
+  std::memcpy(event.record.data(), slot.record, sizeof(slot.record));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  event.sequence = before;
+  return slot.sequence.load(std::memory_order_relaxed) == before;
+}
+
+class FlightRecorder {
+public:
+  static auto instance() -> FlightRecorder & {
+    // Leaked, so that threads ending during shutdown can still detach.
+    static auto *recorder = new FlightRecorder();
+    return *recorder;
+  }
+
+  auto attach() -> OwnedRing * {
+    auto events = depth.load(std::memory_order_relaxed);
+    if (events == 0) {
+      return nullptr;
+    }
+    events = std::bit_ceil(std::min(events, maxDepth));
+    auto owned = std::make_unique<OwnedRing>();
+    owned->slots = std::make_unique<FlightSlot[]>(events);
+    owned->ring = FlightRing{owned->slots.get(), events - 1, 0};
+    owned->thread = ::gettid();
+    auto lock = std::lock_guard(mutex);
+    rings.push_back(std::move(owned));
+    return rings.back().get();
+  }
+
+  void detach(const OwnedRing *ring) {
+    auto lock = std::lock_guard(mutex);
+    std::erase_if(rings, [&](const std::unique_ptr<OwnedRing> &owned) {
+      return owned.get() == ring;
+    });
+  }
+
+  void setDepth(std::size_t events) {
+    depth.store(events, std::memory_order_relaxed);
+  }
+
+  void dump(DecodedRecords &records) {
+    auto lock = std::lock_guard(mutex);
+    // The calling thread goes last, closest to its report.
+    auto self = ::gettid();
+    for (const auto &owned : rings) {
+      if (owned->thread != self) {
+        dumpRing(records, *owned);
+      }
+    }
+    for (const auto &owned : rings) {
+      if (owned->thread == self) {
+        dumpRing(records, *owned);
+      }
+    }
+  }
+
+private:
+  FlightRecorder() = default;
+
+  static void dumpRing(DecodedRecords &records, const OwnedRing &owned) {
+    auto size = owned.ring.mask + 1;
+    auto events = std::vector<Event>(size);
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+      if (readSlot(owned.slots[i], events[count])) {
+        ++count;
+      }
+    }
+    if (count == 0) {
+      return;
+    }
+    events.resize(count);
+    std::ranges::sort(events, {}, &Event::sequence);
+    for (const auto &event : events) {
+      auto header = RecordHeader();
+      std::memcpy(&header, event.record.data(), sizeof(header));
+      records.add(event.record.data(), header,
+                  Entry{.kind = EntryKind::recorded,
+                        .thread = static_cast<std::uint64_t>(owned.thread),
+                        .sequence = event.sequence / 2});
+    }
+  }
+
+  std::atomic<std::size_t> depth = defaultDepth;
+  std::mutex mutex;
+  std::vector<std::unique_ptr<OwnedRing>> rings;
+};
+
+/// Owned by each recording thread; drops its ring when the thread ends.
+struct RingHandle {
+  RingHandle() : ring(FlightRecorder::instance().attach()) {}
+  RingHandle(const RingHandle &) = delete;
+  RingHandle(RingHandle &&) = delete;
+  auto operator=(const RingHandle &) -> RingHandle & = delete;
+  auto operator=(RingHandle &&) -> RingHandle & = delete;
+  ~RingHandle() {
+    localFlightRing = nullptr;
+    exiting = true;
+    if (ring != nullptr) {
+      FlightRecorder::instance().detach(ring);
+    }
+  }
+
+  OwnedRing *ring;
+  static thread_local bool exiting;
+};
+
+thread_local bool RingHandle::exiting = false;
+
+} // namespace
+
+auto attachFlightRing() -> FlightRing * {
+  if (RingHandle::exiting) {
+    return nullptr;
+  }
+  thread_local auto handle = RingHandle();
+  if (handle.ring == nullptr) {
+    return nullptr;
+  }
+  localFlightRing = &handle.ring->ring;
+  return localFlightRing;
+}
+
+void collectFlightRecords(DecodedRecords &records) {
+  FlightRecorder::instance().dump(records);
+}
+
+void decodeOversized(Writer &out, const std::byte *, std::size_t) {
+  out.append("(too large to record)");
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void setFlightRecorderDepth(std::size_t events) {
+  internal::FlightRecorder::instance().setDepth(events);
+}
+
+void dumpFlightRecorder(std::ostream &out) {
+  auto records = internal::DecodedRecords();
+  internal::collectFlightRecords(records);
+  auto text = std::string();
+  encodeText(text, records.entries(), internal::outputColors());
+  out << text;
+}
+
+} // namespace errantibus
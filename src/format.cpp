@@ -0,0 +1,91 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/format.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace errantibus::internal {
+
+namespace {
+
+constexpr std::size_t firstChunkSize = std::size_t{4} << 10;
+
+std::atomic<std::size_t> maxElements = FormatLimits().maxElements;
+std::atomic<std::size_t> maxDepth = FormatLimits().maxDepth;
+std::atomic<std::size_t> maxValueBytes = FormatLimits().maxValueBytes;
+
+} // namespace
+
+auto Arena::local() -> Arena & {
+  thread_local auto arena = Arena();
+  return arena;
+}
+
+void Arena::release(Mark mark) {
+  if (chunks.empty()) {
+    return;
+  }
+  auto position = base + mark.offset;
+  if (mark.chunk < current || (mark.chunk == current && position < cursor)) {
+    current = mark.chunk;
+    base = chunks[current].data.get();
+    cursor = base + mark.offset;
+    limit = base + chunks[current].size;
+    valueStart = cursor;
+  }
+}
+
+auto Arena::grow(std::size_t needed) -> bool {
+  auto partial = static_cast<std::size_t>(cursor - valueStart);
+  auto required = partial + needed;
+  auto next = chunks.empty() ? 0 : current + 1;
+  if (next == chunks.size() || chunks[next].size < required) {
+    auto previous = chunks.empty() ? 0 : chunks[current].size;
+    auto size = std::max({required, 2 * previous, firstChunkSize});
+    try {
+      auto chunk = Chunk{std::make_unique_for_overwrite<char[]>(size), size};
+      if (next == chunks.size()) {
+        chunks.push_back(std::move(chunk));
+      } else {
+        chunks[next] = std::move(chunk);
+      }
+    } catch (const std::bad_alloc &) {
+      return false;
+    }
+  }
+
+  char *start = chunks[next].data.get();
+  if (partial != 0) {
+    std::memcpy(start, valueStart, partial);
+  }
+  current = next;
+  base = start;
+  valueStart = start;
+  cursor = start + partial;
+  limit = start + chunks[next].size;
+  return true;
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void setFormatLimits(const FormatLimits &limits) {
+  internal::maxElements.store(limits.maxElements, std::memory_order_relaxed);
+  internal::maxDepth.store(limits.maxDepth, std::memory_order_relaxed);
+  internal::maxValueBytes.store(limits.maxValueBytes,
+                                std::memory_order_relaxed);
+}
+
+auto formatLimits() -> FormatLimits {
+  return {internal::maxElements.load(std::memory_order_relaxed),
+          internal::maxDepth.load(std::memory_order_relaxed),
+          internal::maxValueBytes.load(std::memory_order_relaxed)};
+}
+
+} // namespace errantibus
@@ -0,0 +1,647 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/output.hpp"
+#include "emergency.hpp"
+#include "report.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+
+namespace errantibus::internal {
+
+namespace {
+
+struct Output {
+  std::mutex mutex;
+  OutputOptions options;
+};
+
+auto output() -> Output & {
+  // Leaked, so that reports can still be written during shutdown.
+  static auto *instance = new Output();
+  return *instance;
+}
+
+auto showColors(const OutputOptions &options) -> bool {
+  return options.colors == ColorMode::always ||
+         (options.colors == ColorMode::automatic && options.sink.terminal());
+}
+
+void writeToFd(void *context, std::string_view data) {
+  writeAll(*static_cast<const int *>(context), data);
+}
+
+/*
+ * Text
+ */
+
+/**
+ * @brief Recorded events of a thread are listed under a heading. The thread
+ * is the one that failed if the next entry that was not recorded is its.
+ */
+void writeRecordedHeading(StringWriter &out, std::span<const Entry> entries,
+                          std::size_t first, bool colors) {
+  auto thread = entries[first].thread;
+  auto end = first;
+  while (end < entries.size() && entries[end].kind == EntryKind::recorded &&
+         entries[end].thread == thread) {
+    ++end;
+  }
+  auto next = end;
+  while (next < entries.size() && entries[next].kind == EntryKind::recorded) {
+    ++next;
+  }
+  bool current = next < entries.size() && entries[next].thread == thread;
+  out << color(yellow, colors) << color(bold, colors) << "Recorded on thread "
+      << thread << (current ? " (this thread)" : "") << ", last "
+      << end - first << " of " << entries[end - 1].sequence << " events:"
+      << color(reset, colors) << '\n';
+}
+
+/*
+ * JSON lines
+ */
+
+constexpr std::array kindNames = {"failure", "check", "summary", "debug",
+                                  "recorded"};
+constexpr std::array roleNames = {"left", "right", "tolerance"};
+
+void appendJsonString(std::string &out, std::string_view text) {
+  constexpr std::string_view hex = "0123456789abcdef";
+  out += '"';
+  for (char c : text) {
+    auto u = static_cast<unsigned char>(c);
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (u < 0x20 || u == 0x7f) {
+        out += "\\u00";
+        out += hex[u >> 4];
+        out += hex[u & 0xf];
+      } else {
+        out += c;
+      }
+    }
+  }
+  out += '"';
+}
+
+/**
+ * @brief Writes the members of one JSON object, skipping empty ones.
+ */
+class JsonObject {
+public:
+  explicit JsonObject(std::string &out) : out(out) { out += '{'; }
+  JsonObject(const JsonObject &) = delete;
+  JsonObject(JsonObject &&) = delete;
+  auto operator=(const JsonObject &) -> JsonObject & = delete;
+  auto operator=(JsonObject &&) -> JsonObject & = delete;
+  ~JsonObject() { out += '}'; }
+
+  void string(std::string_view key, std::string_view value) {
+    if (!value.empty()) {
+      this->key(key);
+      appendJsonString(out, value);
+    }
+  }
+
+  void number(std::string_view key, std::uint64_t value) {
+    if (value != 0) {
+      this->key(key);
+      out += std::to_string(value);
+    }
+  }
+
+  /// Start a member whose value the caller writes.
+  void key(std::string_view key) {
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    appendJsonString(out, key);
+    out += ':';
+  }
+
+private:
+  std::string &out;
+  bool first = true;
+};
+
+void appendJsonStrings(std::string &out,
+                       std::span<const std::string_view> strings) {
+  out += '[';
+  for (std::size_t i = 0; i < strings.size(); ++i) {
+    if (i != 0) {
+      out += ',';
+    }
+    appendJsonString(out, strings[i]);
+  }
+  out += ']';
+}
+
+void appendJsonEntry(std::string &out, const Entry &entry) {
+  auto object = JsonObject(out);
+  object.string("kind", kindNames[static_cast<std::size_t>(entry.kind)]);
+  object.string("file", entry.file);
+  object.number("line", entry.line);
+  object.number("thread", entry.thread);
+  object.string("message", entry.message);
+  object.string("condition", entry.condition);
+  object.string("expectation", entry.expectation);
+  if (!entry.operands.empty()) {
+    object.key("operands");
+    out += '[';
+    for (const auto &operand : entry.operands) {
+      if (&operand != entry.operands.data()) {
+        out += ',';
+      }
+      auto item = JsonObject(out);
+      item.string("role", roleNames[static_cast<std::size_t>(operand.role)]);
+      item.string("expression", operand.expression);
+      item.string("value", operand.value);
+    }
+    out += ']';
+  }
+  if (!entry.range.empty()) {
+    object.key("range");
+    auto range = JsonObject(out);
+    range.string("expression", entry.range);
+    range.key("size");
+    out += std::to_string(entry.excerpt.size);
+    range.key("index");
+    out += std::to_string(entry.excerpt.index);
+    range.key("first");
+    out += std::to_string(entry.excerpt.first);
+    range.key("elements");
+    appendJsonStrings(out, entry.excerpt.values);
+  }
+  if (!entry.values.empty()) {
+    object.key("values");
+    out += '[';
+    for (std::size_t i = 0; i < entry.values.size(); ++i) {
+      if (i != 0) {
+        out += ',';
+      }
+      auto item = JsonObject(out);
+      item.string("expression", entry.expressions[i]);
+      item.key("value");
+      appendJsonString(out, entry.values[i]);
+    }
+    out += ']';
+  }
+  if (!entry.frames.empty()) {
+    object.key("stack");
+    out += '[';
+    for (const auto &frame : entry.frames) {
+      if (&frame != entry.frames.data()) {
+        out += ',';
+      }
+      auto item = JsonObject(out);
+      auto address = std::string();
+      StringWriter(address) << frame.address;
+      item.string("address", address);
+      item.string("function", frame.function);
+      item.string("file", frame.file);
+      item.number("line", frame.line);
+    }
+    out += ']';
+  }
+  object.number("failures", entry.failures);
+  object.number("unreported", entry.unreported);
+  object.number("sequence", entry.sequence);
+  object.string("note", entry.note);
+}
+
+/*
+ * Binary
+ */
+
+enum class Tag : std::uint8_t {
+  kind = 1,
+  file,
+  line,
+  message,
+  thread,
+  condition,
+  expectation,
+  operand,   ///< role, expression, value
+  range,     ///< expression, size, index, first
+  element,   ///< of the range excerpt
+  value,     ///< expression, value
+  frame,     ///< address, function, file, line
+  failures,
+  unreported,
+  sequence,
+  note,
+};
+
+void appendVarint(std::string &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+void appendBytes(std::string &out, std::string_view bytes) {
+  appendVarint(out, bytes.size());
+  out += bytes;
+}
+
+/**
+ * @brief Writes the tagged fields of one entry, skipping empty ones.
+ */
+class BinaryFields {
+public:
+  explicit BinaryFields(std::string &out) : out(out) {}
+
+  void string(Tag tag, std::string_view value) {
+    if (!value.empty()) {
+      this->tag(tag);
+      appendBytes(out, value);
+    }
+  }
+
+  void number(Tag tag, std::uint64_t value) {
+    if (value != 0) {
+      this->tag(tag);
+      appendVarint(out, value);
+    }
+  }
+
+  void tag(Tag tag) { out += static_cast<char>(tag); }
+
+private:
+  std::string &out;
+};
+
+void appendBinaryEntry(std::string &out, const Entry &entry) {
+  auto fields = BinaryFields(out);
+  fields.tag(Tag::kind);
+  appendVarint(out, static_cast<std::uint64_t>(entry.kind));
+  fields.string(Tag::file, entry.file);
+  fields.number(Tag::line, entry.line);
+  fields.string(Tag::message, entry.message);
+  fields.number(Tag::thread, entry.thread);
+  fields.string(Tag::condition, entry.condition);
+  fields.string(Tag::expectation, entry.expectation);
+  for (const auto &operand : entry.operands) {
+    fields.tag(Tag::operand);
+    appendVarint(out, static_cast<std::uint64_t>(operand.role));
+    appendBytes(out, operand.expression);
+    appendBytes(out, operand.value);
+  }
+  if (!entry.range.empty()) {
+    fields.tag(Tag::range);
+    appendBytes(out, entry.range);
+    appendVarint(out, entry.excerpt.size);
+    appendVarint(out, entry.excerpt.index);
+    appendVarint(out, entry.excerpt.first);
+    for (auto element : entry.excerpt.values) {
+      fields.tag(Tag::element);
+      appendBytes(out, element);
+    }
+  }
+  for (std::size_t i = 0; i < entry.values.size(); ++i) {
+    fields.tag(Tag::value);
+    appendBytes(out, entry.expressions[i]);
+    appendBytes(out, entry.values[i]);
+  }
+  for (const auto &frame : entry.frames) {
+    fields.tag(Tag::frame);
+    appendVarint(out, reinterpret_cast<std::uintptr_t>(frame.address));
+    appendBytes(out, frame.function);
+    appendBytes(out, frame.file);
+    appendVarint(out, frame.line);
+  }
+  fields.number(Tag::failures, entry.failures);
+  fields.number(Tag::unreported, entry.unreported);
+  fields.number(Tag::sequence, entry.sequence);
+  fields.string(Tag::note, entry.note);
+}
+
+/**
+ * @brief Reads the fields of one encoded entry. Reading past the end
+ * yields zeros and empty strings and marks the reader as failed.
+ */
+class BinaryReader {
+public:
+  explicit BinaryReader(std::string_view data) : data(data) {}
+
+  auto done() const -> bool { return data.empty(); }
+  auto failed() const -> bool { return broken; }
+
+  auto varint() -> std::uint64_t {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (data.empty()) {
+        break;
+      }
+      auto byte = static_cast<unsigned char>(data.front());
+      data.remove_prefix(1);
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+    broken = true;
+    return 0;
+  }
+
+  auto bytes() -> std::string_view {
+    auto size = varint();
+    if (size > data.size()) {
+      broken = true;
+      return {};
+    }
+    auto result = data.substr(0, size);
+    data.remove_prefix(size);
+    return result;
+  }
+
+private:
+  std::string_view data;
+  bool broken = false;
+};
+
+auto decodeEntry(std::string_view payload, DecodedEntry &decoded) -> bool {
+  auto in = BinaryReader(payload);
+  auto &entry = decoded.entry;
+  while (!in.done() && !in.failed()) {
+    switch (static_cast<Tag>(in.varint())) {
+    case Tag::kind: {
+      auto kind = in.varint();
+      if (kind >= kindNames.size()) {
+        return false;
+      }
+      entry.kind = static_cast<EntryKind>(kind);
+      break;
+    }
+    case Tag::file:
+      entry.file = in.bytes();
+      break;
+    case Tag::line:
+      entry.line = in.varint();
+      break;
+    case Tag::message:
+      entry.message = in.bytes();
+      break;
+    case Tag::thread:
+      entry.thread = in.varint();
+      break;
+    case Tag::condition:
+      entry.condition = in.bytes();
+      break;
+    case Tag::expectation:
+      entry.expectation = in.bytes();
+      break;
+    case Tag::operand: {
+      auto role = in.varint();
+      if (role >= roleNames.size()) {
+        return false;
+      }
+      auto expression = in.bytes();
+      decoded.operands.push_back(
+          {static_cast<OperandRole>(role), expression, in.bytes()});
+      break;
+    }
+    case Tag::range:
+      entry.range = in.bytes();
+      entry.excerpt.size = in.varint();
+      entry.excerpt.index = in.varint();
+      entry.excerpt.first = in.varint();
+      break;
+    case Tag::element:
+      decoded.excerpt.push_back(in.bytes());
+      break;
+    case Tag::value:
+      decoded.expressions.push_back(in.bytes());
+      decoded.values.push_back(in.bytes());
+      break;
+    case Tag::frame: {
+      auto address = in.varint();
+      auto function = in.bytes();
+      auto file = in.bytes();
+      decoded.frames.push_back({reinterpret_cast<const void *>(address),
+                                function, file,
+                                static_cast<std::uint32_t>(in.varint())});
+      break;
+    }
+    case Tag::failures:
+      entry.failures = in.varint();
+      break;
+    case Tag::unreported:
+      entry.unreported = in.varint();
+      break;
+    case Tag::sequence:
+      entry.sequence = in.varint();
+      break;
+    case Tag::note:
+      entry.note = in.bytes();
+      break;
+    default:
+      return false;
+    }
+  }
+  entry.operands = decoded.operands;
+  entry.excerpt.values = decoded.excerpt;
+  entry.expressions = decoded.expressions;
+  entry.values = decoded.values;
+  entry.frames = decoded.frames;
+  return !in.failed();
+}
+
+} // namespace
+
+auto framesOf(std::span<const void *const> addresses,
+              std::span<const std::shared_ptr<const SymbolInfo>> symbols)
+    -> std::vector<Frame> {
+  auto frames = std::vector<Frame>();
+  frames.reserve(addresses.size());
+  for (std::size_t i = 0; i < addresses.size(); ++i) {
+    const auto &symbol = *symbols[i];
+    frames.push_back({addresses[i], symbol.name, symbol.file,
+                      static_cast<std::uint32_t>(symbol.line)});
+  }
+  return frames;
+}
+
+void emit(std::span<const Entry> entries) {
+  auto &config = output();
+  auto lock = std::unique_lock(config.mutex);
+  auto sink = config.options.sink;
+  auto encoder = config.options.encoder;
+  auto colors = showColors(config.options);
+  lock.unlock();
+
+  // Each thread keeps its buffer, unless a sink writes output itself.
+  thread_local auto buffer = std::string();
+  thread_local bool busy = false;
+  bool outer = !busy;
+  auto nested = std::string();
+  auto &text = outer ? buffer : nested;
+  busy = true;
+  text.clear();
+  try {
+    encoder(text, entries, colors);
+    sink.write(text);
+  } catch (...) {
+    busy = !outer;
+    throw;
+  }
+  busy = !outer;
+}
+
+auto outputColors() -> bool {
+  auto &config = output();
+  auto lock = std::lock_guard(config.mutex);
+  return showColors(config.options);
+}
+
+auto decodeBinary(std::string_view data, std::vector<DecodedEntry> &entries)
+    -> bool {
+  while (!data.empty()) {
+    if (data.size() < 4) {
+      return false;
+    }
+    std::uint32_t size = 0;
+    for (int i = 3; i >= 0; --i) {
+      size = (size << 8) | static_cast<unsigned char>(data[i]);
+    }
+    data.remove_prefix(4);
+    if (size > data.size()) {
+      return false;
+    }
+    auto decoded = DecodedEntry();
+    if (!decodeEntry(data.substr(0, size), decoded)) {
+      return false;
+    }
+    // The spans refer to the vectors' storage, which moves along.
+    entries.push_back(std::move(decoded));
+    data.remove_prefix(size);
+  }
+  return true;
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void encodeText(std::string &out, std::span<const Entry> entries,
+                bool colors) {
+  auto writer = internal::StringWriter(out);
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    const auto &entry = entries[i];
+    bool recorded = entry.kind == EntryKind::recorded;
+    bool startsGroup = i == 0 || entries[i - 1].kind != EntryKind::recorded ||
+                       entries[i - 1].thread != entry.thread;
+    if (recorded && startsGroup) {
+      internal::writeRecordedHeading(writer, entries, i, colors);
+    }
+    internal::writeEntryText(writer, entry, colors);
+    bool endsGroup = i + 1 == entries.size() ||
+                     entries[i + 1].kind != EntryKind::recorded ||
+                     entries[i + 1].thread != entry.thread;
+    if (recorded && endsGroup) {
+      writer << '\n';
+    }
+  }
+}
+
+void encodeJsonLines(std::string &out, std::span<const Entry> entries,
+                     [[maybe_unused]] bool colors) {
+  for (const auto &entry : entries) {
+    internal::appendJsonEntry(out, entry);
+    out += '\n';
+  }
+}
+
+void encodeBinary(std::string &out, std::span<const Entry> entries,
+                  [[maybe_unused]] bool colors) {
+  for (const auto &entry : entries) {
+    auto start = out.size();
+    out.append(4, '\0');
+    internal::appendBinaryEntry(out, entry);
+    auto size = static_cast<std::uint32_t>(out.size() - start - 4);
+    for (int i = 0; i < 4; ++i) {
+      out[start + i] = static_cast<char>((size >> (8 * i)) & 0xff);
+    }
+  }
+}
+
+Sink::Sink(WriteFunction write, std::shared_ptr<void> context,
+           bool terminal) :
+    writeData(write), context(std::move(context)), isTerminal(terminal) {}
+
+auto Sink::standardError() -> Sink { return fileDescriptor(STDERR_FILENO); }
+
+auto Sink::fileDescriptor(int fd) -> Sink {
+  return {internal::writeToFd, std::make_shared<int>(fd), ::isatty(fd) == 1};
+}
+
+auto Sink::file(const std::string &path) -> Sink {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                  0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+  auto owned = std::shared_ptr<int>(new int(fd), [](const int *fd) {
+    ::close(*fd);
+    delete fd;
+  });
+  return {internal::writeToFd, std::move(owned), false};
+}
+
+struct MemorySink::Buffer {
+  std::mutex mutex;
+  std::string data;
+};
+
+MemorySink::MemorySink() : buffer(std::make_shared<Buffer>()) {}
+
+auto MemorySink::sink() const -> Sink {
+  auto write = [](void *context, std::string_view data) {
+    auto &buffer = *static_cast<Buffer *>(context);
+    auto lock = std::lock_guard(buffer.mutex);
+    buffer.data += data;
+  };
+  return {write, buffer, false};
+}
+
+auto MemorySink::contents() const -> std::string {
+  auto lock = std::lock_guard(buffer->mutex);
+  return buffer->data;
+}
+
+void MemorySink::clear() {
+  auto lock = std::lock_guard(buffer->mutex);
+  buffer->data.clear();
+}
+
+void setOutput(const OutputOptions &options) {
+  auto &config = internal::output();
+  auto lock = std::lock_guard(config.mutex);
+  config.options = options;
+}
+
+} // namespace errantibus
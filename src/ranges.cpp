@@ -0,0 +1,176 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/ranges.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * The kernels are written with the vector extensions of GCC and Clang, which
+ * map onto SSE2 and NEON. On x86-64, each one is additionally compiled for
+ * AVX2 and picked when the process starts, if the CPU supports it.
+ */
+#if defined(__x86_64__) && defined(__ELF__)
+#define ERRANTIBUS_KERNEL [[gnu::target_clones("avx2", "default")]]
+#else
+#define ERRANTIBUS_KERNEL
+#endif
+
+namespace errantibus::internal {
+
+namespace {
+
+constexpr std::size_t vectorBytes = 32;
+
+template <typename T>
+struct Lanes {
+  static constexpr std::size_t count = vectorBytes / sizeof(T);
+  typedef T Vector __attribute__((vector_size(vectorBytes)));
+};
+
+template <typename T>
+using Vector = typename Lanes<T>::Vector;
+
+/// Four vectors are tested at once, to hide the latency of the reduction.
+/// The loops over them are unrolled, which -O2 would not do on its own.
+constexpr std::size_t blockVectors = 4;
+
+template <typename T>
+constexpr std::size_t blockSize = blockVectors * Lanes<T>::count;
+
+template <typename T>
+using Mask = decltype(Vector<T>{} < Vector<T>{});
+
+template <typename T>
+[[gnu::always_inline]] inline void load(Vector<T> &vector, const T *data) {
+  std::memcpy(&vector, data, sizeof(vector));
+}
+
+/// Whether any lane of a comparison result is set.
+template <typename T>
+[[gnu::always_inline]] inline auto any(const Mask<T> &mask) -> bool {
+  typedef std::uint64_t Words __attribute__((vector_size(vectorBytes)));
+  Words words;
+  std::memcpy(&words, &mask, sizeof(words));
+  return (words[0] | words[1] | words[2] | words[3]) != 0;
+}
+
+template <typename T>
+[[gnu::always_inline]] inline auto outOfRange(const T *data, std::size_t size,
+                                              T lo, T hi) -> std::size_t {
+  Vector<T> low = Vector<T>{} + lo;
+  Vector<T> high = Vector<T>{} + hi;
+  std::size_t i = 0;
+  for (; i + blockSize<T> <= size; i += blockSize<T>) {
+    Mask<T> outside = {};
+#pragma GCC unroll 4
+    for (std::size_t k = 0; k < blockVectors; ++k) {
+      Vector<T> value;
+      load(value, data + i + k * Lanes<T>::count);
+      outside |= (value < low) | (value > high);
+      if constexpr (std::is_floating_point_v<T>) {
+        outside |= value != value;
+      }
+    }
+    if (any<T>(outside)) {
+      break;
+    }
+  }
+  for (; i < size; ++i) {
+    if (!(data[i] >= lo && data[i] <= hi)) {
+      return i;
+    }
+  }
+  return noIndex;
+}
+
+template <typename T>
+[[gnu::always_inline]] inline auto unsorted(const T *data, std::size_t size)
+    -> std::size_t {
+  std::size_t i = 1;
+  for (; i + blockSize<T> <= size; i += blockSize<T>) {
+    Mask<T> descends = {};
+#pragma GCC unroll 4
+    for (std::size_t k = 0; k < blockVectors; ++k) {
+      Vector<T> value;
+      Vector<T> previous;
+      load(value, data + i + k * Lanes<T>::count);
+      load(previous, data + i - 1 + k * Lanes<T>::count);
+      descends |= value < previous;
+    }
+    if (any<T>(descends)) {
+      break;
+    }
+  }
+  for (; i < size; ++i) {
+    if (data[i] < data[i - 1]) {
+      return i;
+    }
+  }
+  return noIndex;
+}
+
+template <typename T>
+[[gnu::always_inline]] inline auto nan(const T *data, std::size_t size)
+    -> std::size_t {
+  std::size_t i = 0;
+  for (; i + blockSize<T> <= size; i += blockSize<T>) {
+    Mask<T> isNaN = {};
+#pragma GCC unroll 4
+    for (std::size_t k = 0; k < blockVectors; ++k) {
+      Vector<T> value;
+      load(value, data + i + k * Lanes<T>::count);
+      isNaN |= value != value;
+    }
+    if (any<T>(isNaN)) {
+      break;
+    }
+  }
+  for (; i < size; ++i) {
+    if (data[i] != data[i]) {
+      return i;
+    }
+  }
+  return noIndex;
+}
+
+} // namespace
+
+#define ERRANTIBUS_DEFINE_RANGE_KERNELS(T)                                     \
+  ERRANTIBUS_KERNEL auto firstOutOfRange(const T *data, std::size_t size,      \
+                                         T lo, T hi) -> std::size_t {          \
+    return outOfRange(data, size, lo, hi);                                     \
+  }                                                                            \
+                                                                               \
+  ERRANTIBUS_KERNEL auto firstUnsorted(const T *data, std::size_t size)        \
+      -> std::size_t {                                                         \
+    return unsorted(data, size);                                               \
+  }
+
+ERRANTIBUS_DEFINE_RANGE_KERNELS(int)
+ERRANTIBUS_DEFINE_RANGE_KERNELS(unsigned)
+ERRANTIBUS_DEFINE_RANGE_KERNELS(long)
+ERRANTIBUS_DEFINE_RANGE_KERNELS(unsigned long)
+ERRANTIBUS_DEFINE_RANGE_KERNELS(long long)
+ERRANTIBUS_DEFINE_RANGE_KERNELS(unsigned long long)
+ERRANTIBUS_DEFINE_RANGE_KERNELS(float)
+ERRANTIBUS_DEFINE_RANGE_KERNELS(double)
+
+#undef ERRANTIBUS_DEFINE_RANGE_KERNELS
+
+ERRANTIBUS_KERNEL auto firstNaN(const float *data, std::size_t size)
+    -> std::size_t {
+  return nan(data, size);
+}
+
+ERRANTIBUS_KERNEL auto firstNaN(const double *data, std::size_t size)
+    -> std::size_t {
+  return nan(data, size);
+}
+
+} // namespace errantibus::internal
@@ -0,0 +1,307 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_REPORT_HPP
+#define ERRANTIBUS_REPORT_HPP
+
+#include "errantibus/asyncDebug.hpp"
+#include "errantibus/format.hpp"
+#include "errantibus/output.hpp"
+#include "sourceCache.hpp"
+#include "symbolizer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace errantibus::internal {
+
+constexpr std::string_view yellow = "\033[33m";
+constexpr std::string_view blue = "\033[34m";
+constexpr std::string_view red = "\033[31m";
+constexpr std::string_view bold = "\033[1m";
+constexpr std::string_view reset = "\033[0m";
+
+/// `code` if colors are shown, nothing otherwise.
+constexpr auto color(std::string_view code, bool colors) -> std::string_view {
+  return colors ? code : std::string_view();
+}
+
+/**
+ * @brief Appends text to a string, with the interface of RawWriter, so that
+ * the templates below write reports to either, or to a std::ostream.
+ */
+class StringWriter {
+public:
+  explicit StringWriter(std::string &text) : text(text) {}
+
+  auto operator<<(std::string_view data) -> StringWriter & {
+    text.append(data);
+    return *this;
+  }
+
+  auto operator<<(const char *data) -> StringWriter & {
+    return *this << std::string_view(data);
+  }
+
+  auto operator<<(char c) -> StringWriter & {
+    text.push_back(c);
+    return *this;
+  }
+
+  template <std::integral T>
+  auto operator<<(T value) -> StringWriter & {
+    char digits[24];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    return *this << std::string_view(digits, end - digits);
+  }
+
+  /// Addresses are written in hex, as `0x...`.
+  auto operator<<(const void *address) -> StringWriter & {
+    char digits[2 * sizeof(void *)];
+    auto [end, ec] =
+        std::to_chars(digits, digits + sizeof(digits),
+                      reinterpret_cast<std::uintptr_t>(address), 16);
+    return *this << "0x" << std::string_view(digits, end - digits);
+  }
+
+private:
+  std::string &text;
+};
+
+constexpr auto decimalDigits(std::int64_t number) -> std::int64_t {
+  std::int64_t count = number < 0 ? 2 : 1;
+  for (number /= 10; number != 0; number /= 10) {
+    ++count;
+  }
+  return count;
+}
+
+/**
+ * @brief Print the lines around `lineNo` of a source file, if it can be read.
+ */
+template <typename Out>
+void writeSourceContext(Out &out, const std::string &filename,
+                        std::size_t lineNo, bool colors) {
+  std::int64_t before = 2;
+  std::int64_t after = 2;
+  auto file = SourceCache::instance().open(filename);
+  if (!file) {
+    return;
+  }
+  auto loc = static_cast<std::int64_t>(lineNo);
+  for (std::int64_t l = std::max<std::int64_t>(1, loc - before);
+       l < loc + after; ++l) {
+    auto line = file->line(static_cast<std::size_t>(l));
+    if (!line) {
+      break;
+    }
+    std::int64_t padding = 8 - decimalDigits(l);
+    for (int k = 0; k < padding; ++k) {
+      out << ' ';
+    }
+    if (l == loc) {
+      out << color(blue, colors);
+      out << "> " << l << " |\t";
+    } else {
+      out << "  " << l << " |\t";
+    }
+    out << *line;
+    if (l == loc) {
+      out << color(reset, colors);
+    }
+    out << '\n';
+  }
+}
+
+/**
+ * @brief Print a symbolized stack trace, outermost frame first, with the
+ * source context of each frame.
+ */
+template <typename Out>
+void writeFrames(Out &out, std::span<const Frame> frames, bool colors) {
+  out << '\n';
+  out << color(yellow, colors) << color(bold, colors)
+      << "Stacktrace (most recent call last):" << color(reset, colors)
+      << '\n';
+  for (auto i = static_cast<int>(frames.size()) - 1; i >= 0; --i) {
+    const auto &frame = frames[i];
+    if (frame.address == nullptr) {
+      continue;
+    }
+    // Numbered as in the full trace, which began with two frames of the
+    // failure handling itself.
+    out << color(yellow, colors) << " #" << i + 2 << " " << frame.function
+        << color(reset, colors) << "\n";
+    out << '\t' << "at " << frame.file << ':' << frame.line << " at "
+        << frame.address << '\n';
+    writeSourceContext(out, std::string(frame.file), frame.line, colors);
+  }
+  out << '\n';
+}
+
+template <typename Out>
+void writeHeader(Out &out, std::string_view file, std::uint64_t line,
+                 std::string_view message, bool colors) {
+  out << color(red, colors) << color(bold, colors) << file << ":" << line;
+  if (!message.empty()) {
+    out << " - " << message;
+  }
+  out << color(reset, colors) << "\n";
+}
+
+/**
+ * @brief Write an entry as text. Entries without frames take neither
+ * memory nor locks, so this also works on the emergency path.
+ */
+template <typename Out>
+void writeEntryText(Out &out, const Entry &entry, bool colors) {
+  if (!entry.frames.empty()) {
+    writeFrames(out, entry.frames, colors);
+  }
+  if (!entry.file.empty()) {
+    writeHeader(out, entry.file, entry.line, entry.message, colors);
+  }
+  if (entry.kind == EntryKind::summary) {
+    out << "   Failed " << entry.unreported << " more times, "
+        << entry.failures << " in total: " << entry.condition << "\n\n";
+    return;
+  }
+  if (!entry.condition.empty()) {
+    out << "Expected true, but was false: " << entry.condition << '\n';
+  }
+  if (!entry.expectation.empty()) {
+    out << "   " << entry.expectation << '\n';
+  }
+  for (const auto &operand : entry.operands) {
+    switch (operand.role) {
+    case OperandRole::left:
+      out << "   Left value:  " << operand.expression << '\n';
+      out << "           is:  " << operand.value << '\n';
+      break;
+    case OperandRole::right:
+      out << "   Right value: " << operand.expression << '\n';
+      out << "            is: " << operand.value << '\n';
+      break;
+    case OperandRole::tolerance:
+      out << "   Tolerance:   " << operand.expression << '\n';
+      out << "           is:  " << operand.value << '\n';
+      break;
+    }
+  }
+  if (!entry.range.empty()) {
+    const auto &excerpt = entry.excerpt;
+    out << "   Range:       " << entry.range << '\n';
+    out << "     of size:   " << excerpt.size << '\n';
+    out << "   First at:    " << excerpt.index << '\n';
+    for (std::size_t i = 0; i < excerpt.values.size(); ++i) {
+      auto at = excerpt.first + i;
+      out << (at == excerpt.index ? "    > [" : "      [") << at << "] "
+          << excerpt.values[i] << '\n';
+    }
+  }
+  for (std::size_t i = 0; i < entry.values.size(); ++i) {
+    out << "\t(" << i << ") " << entry.expressions[i] << " = "
+        << entry.values[i] << "\n";
+  }
+  if (!entry.note.empty()) {
+    out << "   " << entry.note << '\n';
+  }
+  if (entry.kind == EntryKind::failure || entry.kind == EntryKind::check) {
+    out << '\n';
+  }
+}
+
+/**
+ * @brief The frames of a trace with their symbols, which they refer to.
+ */
+auto framesOf(std::span<const void *const> addresses,
+              std::span<const std::shared_ptr<const SymbolInfo>> symbols)
+    -> std::vector<Frame>;
+
+/**
+ * @brief Encode a batch of entries as configured with setOutput, and write
+ * it to the sink in one piece.
+ */
+void emit(std::span<const Entry> entries);
+
+inline void emit(const Entry &entry) { emit(std::span(&entry, 1)); }
+
+/**
+ * @brief Whether the configured output shows colors.
+ */
+auto outputColors() -> bool;
+
+/**
+ * @brief Records of the async `debug(...)` buffers or the flight recorder,
+ * decoded to entries. Their values are formatted into the thread's arena
+ * and released with this object.
+ */
+class DecodedRecords {
+public:
+  DecodedRecords() : arena(Arena::local()), mark(arena.mark()) {}
+  DecodedRecords(const DecodedRecords &) = delete;
+  DecodedRecords(DecodedRecords &&) = delete;
+  auto operator=(const DecodedRecords &) -> DecodedRecords & = delete;
+  auto operator=(DecodedRecords &&) -> DecodedRecords & = delete;
+  ~DecodedRecords() { arena.release(mark); }
+
+  /**
+   * @brief Decode a record. `entry` brings what the record does not know
+   * itself: its kind, thread and sequence number.
+   */
+  void add(const std::byte *record, const RecordHeader &header, Entry entry);
+
+  auto empty() const -> bool { return decoded.empty(); }
+
+  /// The entries decoded so far, valid until the next add.
+  auto entries() -> std::span<const Entry>;
+
+private:
+  Arena &arena;
+  Arena::Mark mark;
+  std::vector<Entry> decoded;
+  /// Where the values of each entry start in `values`, and how many.
+  std::vector<std::pair<std::size_t, std::size_t>> valueRanges;
+  std::vector<std::string_view> values;
+};
+
+/**
+ * @brief Decode the events of the flight recorder, each thread's in order
+ * and the calling thread's last.
+ */
+void collectFlightRecords(DecodedRecords &records);
+
+/**
+ * @brief An entry decoded from encodeBinary's output, with the storage its
+ * spans refer to. Its strings refer to the encoded data.
+ */
+struct DecodedEntry {
+  Entry entry;
+  std::vector<Operand> operands;
+  std::vector<std::string_view> excerpt;
+  std::vector<std::string_view> expressions;
+  std::vector<std::string_view> values;
+  std::vector<Frame> frames;
+};
+
+/**
+ * @brief Decode the output of encodeBinary. Returns false if it is
+ * malformed; the entries up to there are kept.
+ */
+auto decodeBinary(std::string_view data, std::vector<DecodedEntry> &entries)
+    -> bool;
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_REPORT_HPP
@@ -0,0 +1,251 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/siteStatistics.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Provided by the linker for every section whose name is an identifier. Weak,
+// so that a program without any assertion still links.
+extern "C" {
+extern errantibus::internal::CallSite *const
+    __start_errantibus_sites[] __attribute__((weak)); // NOLINT
+extern errantibus::internal::CallSite *const
+    __stop_errantibus_sites[] __attribute__((weak)); // NOLINT
+}
+
+namespace errantibus::internal {
+
+namespace {
+
+/// How often a thread looks whether sampling was turned on while it is off.
+constexpr std::uint32_t idleCountdown = std::uint32_t{1} << 16;
+
+std::atomic<std::uint32_t> sampleInterval = 0;
+
+/**
+ * @brief A countdown averaging `interval`. Randomized, so that sites that
+ * always run in the same order all get sampled.
+ */
+auto nextCountdown(std::uint32_t interval) -> std::uint32_t {
+  thread_local std::uint32_t state = 0x9e3779b9U;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  if (interval == 1) {
+    return 1;
+  }
+  return 1 + state % (2 * interval - 1);
+}
+
+/**
+ * @brief All sites in the section, each once. A site appears several times
+ * if its function was inlined; entries may also be padding.
+ */
+auto callSites() -> std::vector<CallSite *> {
+  if (__start_errantibus_sites == nullptr) {
+    return {};
+  }
+  auto sites = std::vector<CallSite *>();
+  std::copy_if(__start_errantibus_sites, __stop_errantibus_sites,
+               std::back_inserter(sites),
+               [](const CallSite *site) { return site != nullptr; });
+  std::sort(sites.begin(), sites.end(),
+            [](const CallSite *a, const CallSite *b) {
+              auto byLocation = std::strcmp(a->file, b->file);
+              if (byLocation != 0) {
+                return byLocation < 0;
+              }
+              return a->line != b->line ? a->line < b->line : a < b;
+            });
+  sites.erase(std::unique(sites.begin(), sites.end()), sites.end());
+  return sites;
+}
+
+/**
+ * @brief Owns the counters of all threads. The counters of a thread that
+ * ends are added to the totals, so nothing counted is lost.
+ */
+class CounterRegistry {
+public:
+  static auto instance() -> CounterRegistry & {
+    // Leaked, so that threads ending during static destruction still work.
+    static auto *registry = new CounterRegistry();
+    return *registry;
+  }
+
+  auto attach() -> SiteCounter * {
+    auto lock = std::lock_guard(mutex);
+    auto counters = std::make_unique<SiteCounter[]>(totals.size());
+    auto *raw = counters.get();
+    live.push_back(std::move(counters));
+    return raw;
+  }
+
+  void detach(SiteCounter *counters) {
+    auto lock = std::lock_guard(mutex);
+    auto it = std::find_if(live.begin(), live.end(),
+                           [&](const auto &c) { return c.get() == counters; });
+    if (it == live.end()) {
+      return;
+    }
+    addTo(totals, counters);
+    live.erase(it);
+  }
+
+  auto snapshot() -> std::vector<SiteStatistics> {
+    auto lock = std::lock_guard(mutex);
+    auto result = totals;
+    for (const auto &counters : live) {
+      addTo(result, counters.get());
+    }
+    return result;
+  }
+
+private:
+  CounterRegistry() {
+    auto sites = callSites();
+    totals.reserve(sites.size() + 1);
+    totals.push_back({"", "", 0, "", 0, 0, 0});
+    for (auto *site : sites) {
+      site->index = static_cast<std::uint32_t>(totals.size());
+      totals.push_back({site->kind, site->file, site->line, site->condition,
+                        0, 0, 0});
+    }
+  }
+
+  static void addTo(std::vector<SiteStatistics> &statistics,
+                    const SiteCounter *counters) {
+    for (std::size_t i = 0; i < statistics.size(); ++i) {
+      const auto &counter = counters[i];
+      statistics[i].evaluations +=
+          counter.evaluations.load(std::memory_order_relaxed);
+      statistics[i].samples += counter.samples.load(std::memory_order_relaxed);
+      statistics[i].sampledCycles +=
+          counter.sampledCycles.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::mutex mutex;
+  std::vector<std::unique_ptr<SiteCounter[]>> live;
+  std::vector<SiteStatistics> totals;
+};
+
+/// Hands a thread's counters back to the registry when the thread ends.
+struct CounterHandle {
+  CounterHandle() : counters(CounterRegistry::instance().attach()) {}
+  CounterHandle(const CounterHandle &) = delete;
+  CounterHandle(CounterHandle &&) = delete;
+  auto operator=(const CounterHandle &) -> CounterHandle & = delete;
+  auto operator=(CounterHandle &&) -> CounterHandle & = delete;
+  ~CounterHandle() {
+    localSiteCounters = nullptr;
+    CounterRegistry::instance().detach(counters);
+  }
+
+  SiteCounter *counters;
+};
+
+auto estimatedCycles(const SiteStatistics &site) -> double {
+  if (site.samples == 0) {
+    return 0;
+  }
+  return static_cast<double>(site.sampledCycles) /
+         static_cast<double>(site.samples) *
+         static_cast<double>(site.evaluations);
+}
+
+} // namespace
+
+auto attachSiteCounters() -> SiteCounter * {
+  thread_local auto handle = CounterHandle();
+  localSiteCounters = handle.counters;
+  sampleCountdown = idleCountdown;
+  return handle.counters;
+}
+
+auto startSample() -> std::uint64_t {
+  auto interval = sampleInterval.load(std::memory_order_relaxed);
+  if (interval == 0) {
+    sampleCountdown = idleCountdown;
+    return 0;
+  }
+  sampleCountdown = nextCountdown(interval);
+  return cycleCount();
+}
+
+void recordSample(const CallSite &site, std::uint64_t start) {
+  auto elapsed = cycleCount() - start;
+  auto &counter = localSiteCounters[site.index];
+  counter.samples.store(counter.samples.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+  counter.sampledCycles.store(
+      counter.sampledCycles.load(std::memory_order_relaxed) + elapsed,
+      std::memory_order_relaxed);
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+auto siteStatistics() -> std::vector<SiteStatistics> {
+  auto sites = internal::CounterRegistry::instance().snapshot();
+  if (sites.front().evaluations == 0) {
+    sites.erase(sites.begin());
+  }
+  return sites;
+}
+
+void dumpSiteStatistics(std::ostream &out) {
+  auto sites = siteStatistics();
+  std::stable_sort(sites.begin(), sites.end(),
+                   [](const SiteStatistics &a, const SiteStatistics &b) {
+                     auto costA = internal::estimatedCycles(a);
+                     auto costB = internal::estimatedCycles(b);
+                     if (costA != costB) {
+                       return costA > costB;
+                     }
+                     return a.evaluations > b.evaluations;
+                   });
+
+  auto flags = out.flags();
+  auto precision = out.precision();
+  out << std::setw(14) << "evaluations" << std::setw(14) << "cycles/eval"
+      << std::setw(16) << "est. cycles"
+      << "  site\n";
+  for (const auto &site : sites) {
+    out << std::setw(14) << site.evaluations;
+    if (site.samples != 0) {
+      out << std::fixed << std::setprecision(1) << std::setw(14)
+          << static_cast<double>(site.sampledCycles) /
+                 static_cast<double>(site.samples)
+          << std::setprecision(0) << std::setw(16)
+          << internal::estimatedCycles(site);
+    } else {
+      out << std::setw(14) << "-" << std::setw(16) << "-";
+    }
+    if (site.line == 0) {
+      out << "  (sites in shared objects)\n";
+      continue;
+    }
+    out << "  " << site.file << ':' << site.line << ' ' << site.kind << '('
+        << site.condition << ")\n";
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void setCycleSampling(std::uint32_t interval) {
+  internal::sampleInterval.store(interval, std::memory_order_relaxed);
+}
+
+} // namespace errantibus
@@ -0,0 +1,130 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "sourceCache.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+namespace errantibus::internal {
+
+SourceFile::SourceFile(const std::string &filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat info{};
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    ::close(fd);
+    return;
+  }
+  // The size is only a hint: the file may change while it is read.
+  text.resize(static_cast<std::size_t>(info.st_size));
+  std::size_t size = 0;
+  opened = true;
+  while (true) {
+    if (size == text.size()) {
+      text.resize(size + std::max<std::size_t>(size, 4096));
+    }
+    auto count = ::read(fd, text.data() + size, text.size() - size);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0) {
+      opened = false;
+    }
+    if (count <= 0) {
+      break;
+    }
+    size += static_cast<std::size_t>(count);
+  }
+  text.resize(size);
+  text.shrink_to_fit();
+  ::close(fd);
+  lineStarts.push_back(0);
+}
+
+auto SourceFile::line(std::size_t lineNo) const
+    -> std::optional<std::string_view> {
+  if (lineNo == 0 || text.empty()) {
+    return std::nullopt;
+  }
+  auto lock = std::lock_guard(mutex);
+  // Extend the index up to the start of the line after the requested one.
+  while (lineStarts.size() <= lineNo && lineStarts.back() < text.size()) {
+    auto newline = text.find('\n', lineStarts.back());
+    lineStarts.push_back(newline == std::string::npos ? text.size()
+                                                      : newline + 1);
+  }
+  if (lineNo >= lineStarts.size()) {
+    return std::nullopt;
+  }
+  auto start = lineStarts[lineNo - 1];
+  auto end = lineStarts[lineNo];
+  auto content = std::string_view(text).substr(start, end - start);
+  if (content.ends_with('\n')) {
+    content.remove_suffix(1);
+  }
+  if (content.ends_with('\r')) {
+    content.remove_suffix(1);
+  }
+  return content;
+}
+
+auto SourceFile::footprint() const -> std::size_t {
+  auto lock = std::lock_guard(mutex);
+  return text.capacity() + lineStarts.capacity() * sizeof(std::size_t);
+}
+
+SourceCache::SourceCache(std::size_t budget) : budget(budget) {}
+
+auto SourceCache::instance() -> SourceCache & {
+  static auto *cache = new SourceCache();
+  return *cache;
+}
+
+auto SourceCache::open(const std::string &filename)
+    -> std::shared_ptr<const SourceFile> {
+  auto lock = std::lock_guard(mutex);
+  if (auto found = files.find(filename); found != files.end()) {
+    recent.splice(recent.begin(), recent, found->second);
+    return found->second->second;
+  }
+
+  auto file = std::make_shared<const SourceFile>(filename);
+  if (!file->valid()) {
+    return nullptr;
+  }
+  recent.emplace_front(filename, file);
+  files.emplace(filename, recent.begin());
+  evict();
+  return file;
+}
+
+void SourceCache::setBudget(std::size_t bytes) {
+  auto lock = std::lock_guard(mutex);
+  budget = bytes;
+  evict();
+}
+
+void SourceCache::evict() {
+  std::size_t used = 0;
+  for (const auto &[name, file] : recent) {
+    used += file->footprint();
+  }
+  // The most recently used file always stays, even if it alone is too big.
+  while (used > budget && recent.size() > 1) {
+    auto &[name, file] = recent.back();
+    used -= file->footprint();
+    files.erase(name);
+    recent.pop_back();
+  }
+}
+
+} // namespace errantibus::internal
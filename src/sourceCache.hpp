@@ -0,0 +1,86 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_SOURCE_CACHE_HPP
+#define ERRANTIBUS_SOURCE_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace errantibus::internal {
+
+/**
+ * @brief A source file, read into memory once. It is not mapped: a file
+ * that is truncated while the program runs would make reading the mapping
+ * fault, and turn a report into a crash. The offsets of its lines are only
+ * computed as far as they have been asked for.
+ */
+class SourceFile {
+public:
+  explicit SourceFile(const std::string &filename);
+  SourceFile(const SourceFile &) = delete;
+  SourceFile(SourceFile &&) = delete;
+  auto operator=(const SourceFile &) -> SourceFile & = delete;
+  auto operator=(SourceFile &&) -> SourceFile & = delete;
+
+  auto valid() const -> bool { return opened; }
+
+  /**
+   * @brief The contents of line `lineNo` (1-based) without its line break,
+   * or nothing if the file is shorter. The view points into the file.
+   */
+  auto line(std::size_t lineNo) const -> std::optional<std::string_view>;
+
+  /**
+   * @brief Approximate memory held by this file: contents and line index.
+   */
+  auto footprint() const -> std::size_t;
+
+private:
+  std::string text;
+  bool opened = false;
+  mutable std::mutex mutex;
+  /// Start offsets of the lines found so far; lineStarts[0] is line 1.
+  mutable std::vector<std::size_t> lineStarts;
+};
+
+/**
+ * @brief Keeps recently used source files in memory, within a budget.
+ * Files are evicted least recently used first; files still in use by a
+ * caller stay loaded until the caller lets go of them.
+ */
+class SourceCache {
+public:
+  static constexpr std::size_t defaultBudget = std::size_t{64} << 20;
+
+  explicit SourceCache(std::size_t budget = defaultBudget);
+
+  static auto instance() -> SourceCache &;
+
+  auto open(const std::string &filename) -> std::shared_ptr<const SourceFile>;
+
+  void setBudget(std::size_t bytes);
+
+private:
+  using Entry = std::pair<std::string, std::shared_ptr<const SourceFile>>;
+
+  void evict();
+
+  std::mutex mutex;
+  std::size_t budget;
+  std::list<Entry> recent;
+  std::unordered_map<std::string, std::list<Entry>::iterator> files;
+};
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_SOURCE_CACHE_HPP
@@ -0,0 +1,182 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/stackCapture.hpp"
+#include "report.hpp"
+#include "symbolizer.hpp"
+
+#include <pthread.h>
+#include <unwind.h>
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+namespace errantibus::internal {
+
+namespace {
+
+struct UnwindState {
+  std::span<const void *> frames;
+  std::size_t skip;
+  std::size_t count = 0;
+};
+
+auto collectFrame(_Unwind_Context *context, void *data) -> _Unwind_Reason_Code {
+  auto &state = *static_cast<UnwindState *>(data);
+  auto ip = _Unwind_GetIP(context);
+  if (ip == 0) {
+    return _URC_END_OF_STACK;
+  }
+  if (state.skip > 0) {
+    --state.skip;
+    return _URC_NO_REASON;
+  }
+  state.frames[state.count++] = reinterpret_cast<const void *>(ip);
+  return state.count == state.frames.size() ? _URC_END_OF_STACK
+                                            : _URC_NO_REASON;
+}
+
+#ifdef ERRANTIBUS_FRAME_POINTERS
+
+/**
+ * @brief The highest address of the calling thread's stack. Frame pointers
+ * beyond it, or below the current frame, are not followed.
+ */
+auto stackTop() -> std::uintptr_t {
+  thread_local std::uintptr_t top = [] {
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) != 0) {
+      return std::uintptr_t{0};
+    }
+    void *base = nullptr;
+    std::size_t size = 0;
+    pthread_attr_getstack(&attributes, &base, &size);
+    pthread_attr_destroy(&attributes);
+    return reinterpret_cast<std::uintptr_t>(base) + size;
+  }();
+  return top;
+}
+
+/**
+ * @brief Follow the chain of saved frame pointers. Each frame starts with
+ * the frame pointer of its caller, followed by the return address into it,
+ * on x86-64 as on AArch64.
+ */
+[[gnu::noinline]] auto walkFramePointers(std::span<const void *> frames,
+                                         std::size_t skip) -> std::size_t {
+  auto top = stackTop();
+  auto frame =
+      reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0));
+  std::size_t count = 0;
+  while (count < frames.size()) {
+    if (frame == 0 || frame % alignof(void *) != 0 ||
+        frame + 2 * sizeof(void *) > top) {
+      break;
+    }
+    const auto *slots = reinterpret_cast<const std::uintptr_t *>(frame);
+    auto caller = slots[0];
+    const auto *returnAddress = reinterpret_cast<const void *>(slots[1]);
+    if (returnAddress == nullptr) {
+      break;
+    }
+    if (skip > 0) {
+      --skip;
+    } else {
+      frames[count++] = returnAddress;
+    }
+    // Stacks grow down, so the caller's frame must be above this one.
+    if (caller <= frame) {
+      break;
+    }
+    frame = caller;
+  }
+  return count;
+}
+
+#endif
+
+/**
+ * @brief Use `count` after the call that returned it. This keeps that call
+ * from becoming a tail call, which would remove the caller's frame before
+ * the frames to skip are counted.
+ */
+[[gnu::always_inline]] inline auto keepFrame(std::size_t count)
+    -> std::size_t {
+  asm volatile("" : "+r"(count));
+  return count;
+}
+
+void appendAddress(Writer &out, const void *address) {
+  char digits[2 * sizeof(void *)];
+  auto [end, ec] =
+      std::to_chars(digits, digits + sizeof(digits),
+                    reinterpret_cast<std::uintptr_t>(address), 16);
+  out.append("0x");
+  out.append(std::string_view(digits, end));
+}
+
+} // namespace
+
+auto unwindStack(std::span<const void *> frames, std::size_t skip)
+    -> std::size_t {
+  if (frames.empty()) {
+    return 0;
+  }
+  // The unwinder starts in this function.
+  auto state = UnwindState{frames, skip + 1};
+  _Unwind_Backtrace(collectFrame, &state);
+  return state.count;
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+auto captureStack(std::span<const void *> frames, std::size_t skip)
+    -> std::size_t {
+#ifdef ERRANTIBUS_FRAME_POINTERS
+  // The walk starts in walkFramePointers, whose return address is in here.
+  return internal::keepFrame(internal::walkFramePointers(frames, skip + 1));
+#else
+  return internal::keepFrame(internal::unwindStack(frames, skip + 1));
+#endif
+}
+
+void printStack(std::ostream &out, std::span<const void *const> frames) {
+  auto symbols = internal::Symbolizer::instance().resolve(frames);
+  internal::writeFrames(out, internal::framesOf(frames, symbols),
+                        internal::outputColors());
+}
+
+auto captureBacktrace(std::size_t skip) -> Backtrace {
+  auto trace = Backtrace();
+  trace.size = static_cast<std::uint32_t>(
+      captureStack(trace.addresses, skip + 1));
+  return trace;
+}
+
+void errantibusFormat(Writer &out, const Backtrace &trace) {
+  auto frames = trace.frames();
+  auto symbols = internal::Symbolizer::instance().resolve(frames);
+  for (std::size_t i = 0; i < frames.size() && !out.exhausted(); ++i) {
+    const auto &symbol = *symbols[i];
+    out.append("\n\t    #");
+    out.appendNumber(i);
+    out.append(' ');
+    out.append(symbol.name.empty() ? std::string_view("??") : symbol.name);
+    if (!symbol.file.empty()) {
+      out.append(" at ");
+      out.append(symbol.file);
+      out.append(':');
+      out.appendNumber(symbol.line);
+    } else {
+      out.append(" at ");
+      internal::appendAddress(out, frames[i]);
+    }
+  }
+}
+
+} // namespace errantibus
@@ -0,0 +1,190 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/switchable.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace errantibus::internal {
+
+namespace {
+
+constexpr const char *environmentVariable = "ERRANTIBUS_ASSERTIONS";
+
+struct Selector {
+  enum class Kind { all, tag, file };
+
+  Kind kind = Kind::all;
+  std::string pattern;
+  bool enable = true;
+
+  auto matches(const SwitchSite &site) const -> bool {
+    switch (kind) {
+    case Kind::all:
+      return true;
+    case Kind::tag:
+      return pattern == site.tag;
+    case Kind::file: {
+      auto file = std::string_view(site.file);
+      if (!file.ends_with(pattern)) {
+        return false;
+      }
+      // Only match whole path components.
+      auto rest = file.size() - pattern.size();
+      return rest == 0 || file[rest - 1] == '/' || pattern.starts_with('/');
+    }
+    }
+    return false;
+  }
+};
+
+auto trim(std::string_view text) -> std::string_view {
+  while (!text.empty() && text.front() == ' ') {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && text.back() == ' ') {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+auto parseSelector(std::string_view text, bool enable)
+    -> std::optional<Selector> {
+  if (text.starts_with('-')) {
+    enable = !enable;
+    text.remove_prefix(1);
+  }
+  if (text == "all") {
+    return Selector{Selector::Kind::all, "", enable};
+  }
+  if (text.starts_with("tag:") && text.size() > 4) {
+    return Selector{Selector::Kind::tag, std::string(text.substr(4)), enable};
+  }
+  if (text.starts_with("file:") && text.size() > 5) {
+    return Selector{Selector::Kind::file, std::string(text.substr(5)), enable};
+  }
+  return std::nullopt;
+}
+
+/**
+ * @brief The selectors, and every site that has been resolved against them.
+ * Sites register on their first run, so changing the selectors can update
+ * exactly the sites that cached a state.
+ */
+class SwitchRegistry {
+public:
+  static auto instance() -> SwitchRegistry & {
+    // Leaked, so that assertions in static destructors still work.
+    static auto *registry = new SwitchRegistry();
+    return *registry;
+  }
+
+  auto resolve(SwitchSite &site) -> bool {
+    auto lock = std::lock_guard(mutex);
+    if (site.state.load(std::memory_order_relaxed) ==
+        SwitchState::unresolved) {
+      site.next = sites;
+      sites = &site;
+    }
+    auto state = stateOf(site);
+    site.state.store(state, std::memory_order_relaxed);
+    return state == SwitchState::on;
+  }
+
+  void add(std::string_view selectors, bool enable) {
+    auto lock = std::lock_guard(mutex);
+    while (!selectors.empty()) {
+      auto end = selectors.find(',');
+      auto item = trim(selectors.substr(0, end));
+      selectors.remove_prefix(end == std::string_view::npos ? selectors.size()
+                                                            : end + 1);
+      if (item.empty()) {
+        continue;
+      }
+      if (auto selector = parseSelector(item, enable)) {
+        replaceRule(std::move(*selector));
+      } else {
+        std::cerr << "errantibus: ignoring unknown assertion selector '"
+                  << item << "'\n";
+      }
+    }
+    update();
+  }
+
+  void reset() {
+    auto lock = std::lock_guard(mutex);
+    rules.clear();
+    update();
+  }
+
+private:
+  SwitchRegistry() {
+    if (const char *selectors = std::getenv(environmentVariable)) {
+      add(selectors, true);
+    }
+  }
+
+  /**
+   * @brief Add a rule after all others, where it takes precedence. Rules it
+   * overrides completely are dropped, so that toggling the same selectors
+   * again and again does not grow the list.
+   */
+  void replaceRule(Selector selector) {
+    if (selector.kind == Selector::Kind::all) {
+      rules.clear();
+    } else {
+      std::erase_if(rules, [&](const Selector &rule) {
+        return rule.kind == selector.kind && rule.pattern == selector.pattern;
+      });
+    }
+    rules.push_back(std::move(selector));
+  }
+
+  auto stateOf(const SwitchSite &site) const -> SwitchState {
+    for (auto rule = rules.rbegin(); rule != rules.rend(); ++rule) {
+      if (rule->matches(site)) {
+        return rule->enable ? SwitchState::on : SwitchState::off;
+      }
+    }
+    return SwitchState::off;
+  }
+
+  void update() {
+    for (auto *site = sites; site != nullptr; site = site->next) {
+      site->state.store(stateOf(*site), std::memory_order_relaxed);
+    }
+  }
+
+  std::mutex mutex;
+  std::vector<Selector> rules;
+  SwitchSite *sites = nullptr;
+};
+
+} // namespace
+
+auto resolveSwitch(SwitchSite &site) -> bool {
+  return SwitchRegistry::instance().resolve(site);
+}
+
+} // namespace errantibus::internal
+
+namespace errantibus {
+
+void enableAssertions(std::string_view selectors) {
+  internal::SwitchRegistry::instance().add(selectors, true);
+}
+
+void disableAssertions(std::string_view selectors) {
+  internal::SwitchRegistry::instance().add(selectors, false);
+}
+
+void resetAssertions() { internal::SwitchRegistry::instance().reset(); }
+
+} // namespace errantibus
@@ -0,0 +1,397 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "symbolizer.hpp"
+
+#include <boost/core/demangle.hpp>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <optional>
+
+extern char **environ; // NOLINT
+
+namespace errantibus::internal {
+
+namespace {
+
+#ifdef ERRANTIBUS_ADDR2LINE_LOCATION
+constexpr const char *addr2linePath = ERRANTIBUS_ADDR2LINE_LOCATION;
+#else
+constexpr const char *addr2linePath = "/usr/bin/addr2line";
+#endif
+
+/// Addresses sent to a helper before its answers are read back, so that
+/// neither side can fill up its pipe while the other one is still writing.
+constexpr std::size_t maxBatch = 64;
+
+/// How long a helper may take to answer a batch. Loading the debug
+/// information of a large module on the first query takes a while, but a
+/// helper that takes longer is assumed to hang, and a report must not.
+constexpr auto answerTimeout = std::chrono::seconds(10);
+
+/// Addresses the cache holds; it starts over once there are more.
+constexpr std::size_t maxCached = std::size_t{1} << 14;
+
+auto executablePath() -> const std::string & {
+  static const auto path = [] {
+    auto buffer = std::array<char, 4096>();
+    auto length = readlink("/proc/self/exe", buffer.data(), buffer.size() - 1);
+    return length > 0 ? std::string(buffer.data(), length) : std::string();
+  }();
+  return path;
+}
+
+struct Module {
+  std::string path;
+  std::uintptr_t bias = 0;
+};
+
+auto findModule(std::uintptr_t address) -> std::optional<Module> {
+  struct Search {
+    std::uintptr_t address;
+    std::optional<Module> result;
+  } search{address, std::nullopt};
+
+  dl_iterate_phdr(
+      [](dl_phdr_info *info, std::size_t, void *data) -> int {
+        auto *search = static_cast<Search *>(data);
+        for (int i = 0; i < info->dlpi_phnum; ++i) {
+          const auto &header = info->dlpi_phdr[i];
+          if (header.p_type != PT_LOAD) {
+            continue;
+          }
+          auto start = info->dlpi_addr + header.p_vaddr;
+          if (search->address >= start &&
+              search->address < start + header.p_memsz) {
+            const char *name = info->dlpi_name;
+            search->result = Module{
+                (name == nullptr || *name == '\0') ? executablePath() : name,
+                info->dlpi_addr};
+            return 1;
+          }
+        }
+        return 0;
+      },
+      &search);
+  return search.result;
+}
+
+void writeHex(std::string &out, std::uintptr_t value) {
+  std::array<char, 2 * sizeof(value) + 1> digits{};
+  auto [end, ec] =
+      std::to_chars(digits.data(), digits.data() + digits.size(), value, 16);
+  out += "0x";
+  out.append(digits.data(), end);
+  out += '\n';
+}
+
+/// Parses the `file:line` answer of addr2line, which may carry a
+/// trailing ` (discriminator N)`.
+void parseLocation(std::string_view text, SymbolInfo &info) {
+  if (auto paren = text.find(" ("); paren != std::string_view::npos) {
+    text = text.substr(0, paren);
+  }
+  auto colon = text.rfind(':');
+  if (colon == std::string_view::npos) {
+    return;
+  }
+  auto file = text.substr(0, colon);
+  auto line = text.substr(colon + 1);
+  if (file != "??") {
+    info.file = file;
+  }
+  std::from_chars(line.data(), line.data() + line.size(), info.line);
+}
+
+void fallbackName(const void *address, SymbolInfo &info) {
+  Dl_info dl{};
+  if (dladdr(address, &dl) != 0 && dl.dli_sname != nullptr) {
+    info.name = boost::core::demangle(dl.dli_sname);
+  }
+}
+
+} // namespace
+
+/**
+ * @brief A running `addr2line -f -C -e <module>` that reads addresses from
+ * its stdin and answers each with two lines on its stdout.
+ */
+class Symbolizer::Helper {
+public:
+  explicit Helper(const std::string &module) {
+    std::array<int, 2> toChild{-1, -1};
+    std::array<int, 2> fromChild{-1, -1};
+    // A socket instead of a pipe, so that a crashed helper shows up as an
+    // error from send() rather than as SIGPIPE.
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, toChild.data())
+        != 0) {
+      return;
+    }
+    if (pipe2(fromChild.data(), O_CLOEXEC) != 0) {
+      close(toChild[0]);
+      close(toChild[1]);
+      return;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, toChild[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fromChild[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+
+    std::string program = addr2linePath;
+    std::string functions = "-fC";
+    std::string exe = "-e";
+    std::string path = module;
+    std::array<char *, 5> argv = {program.data(), functions.data(),
+                                  exe.data(), path.data(), nullptr};
+    int status = posix_spawn(&pid, addr2linePath, &actions, nullptr,
+                             argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(toChild[0]);
+    close(fromChild[1]);
+    if (status != 0) {
+      pid = -1;
+      close(toChild[1]);
+      close(fromChild[0]);
+      return;
+    }
+    input = toChild[1];
+    output = fromChild[0];
+  }
+
+  Helper(const Helper &) = delete;
+  Helper(Helper &&) = delete;
+  auto operator=(const Helper &) -> Helper & = delete;
+  auto operator=(Helper &&) -> Helper & = delete;
+
+  ~Helper() { shutdown(); }
+
+  /**
+   * @brief Look up `offsets` and fill in `results` in the same order.
+   * On failure or timeout the helper shuts down and the remaining results
+   * stay empty.
+   */
+  void query(std::span<const std::uintptr_t> offsets,
+             std::span<SymbolInfo *const> results) {
+    for (std::size_t done = 0; done < offsets.size() && alive();
+         done += maxBatch) {
+      auto count = std::min(maxBatch, offsets.size() - done);
+      auto request = std::string();
+      for (std::size_t i = 0; i < count; ++i) {
+        writeHex(request, offsets[done + i]);
+      }
+      if (!writeAll(request)) {
+        shutdown();
+        return;
+      }
+      auto deadline = std::chrono::steady_clock::now() + answerTimeout;
+      auto line = std::string();
+      for (std::size_t i = 0; i < count; ++i) {
+        auto &info = *results[done + i];
+        if (!readLine(line, deadline)) {
+          shutdown();
+          return;
+        }
+        if (line != "??") {
+          info.name = line;
+        }
+        if (!readLine(line, deadline)) {
+          shutdown();
+          return;
+        }
+        parseLocation(line, info);
+      }
+    }
+  }
+
+  auto alive() const -> bool { return output >= 0; }
+
+private:
+  /**
+   * @brief Read the next line of the answer, without its line break.
+   * Fails at the end of the output, or if it is not there by `deadline`.
+   */
+  auto readLine(std::string &line,
+                std::chrono::steady_clock::time_point deadline) -> bool {
+    while (true) {
+      if (auto newline = received.find('\n');
+          newline != std::string::npos) {
+        line.assign(received, 0, newline);
+        received.erase(0, newline + 1);
+        return true;
+      }
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      auto ready = pollfd{output, POLLIN, 0};
+      int polled = left.count() > 0
+                       ? poll(&ready, 1, static_cast<int>(left.count()))
+                       : 0;
+      if (polled < 0 && errno == EINTR) {
+        continue;
+      }
+      if (polled <= 0) {
+        return false;
+      }
+      std::array<char, 4096> chunk; // NOLINT: not initialized on purpose
+      auto count = read(output, chunk.data(), chunk.size());
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (count <= 0) {
+        return false;
+      }
+      received.append(chunk.data(), static_cast<std::size_t>(count));
+    }
+  }
+
+  auto writeAll(std::string_view data) const -> bool {
+    while (!data.empty()) {
+      auto written = send(input, data.data(), data.size(), MSG_NOSIGNAL);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        return false;
+      }
+      data.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+  }
+
+  void shutdown() {
+    if (input >= 0) {
+      close(input);
+      input = -1;
+    }
+    if (output >= 0) {
+      close(output);
+      output = -1;
+    }
+    if (pid > 0) {
+      int status = 0;
+      kill(pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      pid = -1;
+    }
+  }
+
+  pid_t pid = -1;
+  int input = -1;
+  int output = -1;
+  /// Answers read but not yet consumed.
+  std::string received;
+};
+
+Symbolizer::Symbolizer() = default;
+Symbolizer::~Symbolizer() = default;
+
+auto Symbolizer::instance() -> Symbolizer & {
+  static auto *symbolizer = new Symbolizer();
+  return *symbolizer;
+}
+
+auto Symbolizer::helperFor(const std::string &module) -> Helper * {
+  auto &helper = helpers[module];
+  if (!helper) {
+    helper = std::make_unique<Helper>(module);
+  }
+  return helper->alive() ? helper.get() : nullptr;
+}
+
+auto Symbolizer::resolve(std::span<const void *const> addresses)
+    -> std::vector<std::shared_ptr<const SymbolInfo>> {
+  auto lock = std::lock_guard(mutex);
+  auto results =
+      std::vector<std::shared_ptr<const SymbolInfo>>(addresses.size());
+  if (cache.size() + addresses.size() > maxCached) {
+    // Results handed out before keep their entries alive.
+    cache.clear();
+  }
+
+  struct Pending {
+    std::vector<std::uintptr_t> offsets;
+    std::vector<SymbolInfo *> infos;
+  };
+  auto pending = std::unordered_map<std::string, Pending>();
+  auto fresh = std::vector<std::pair<const void *, SymbolInfo *>>();
+
+  for (std::size_t i = 0; i < addresses.size(); ++i) {
+    auto address = reinterpret_cast<std::uintptr_t>(addresses[i]);
+    auto [entry, inserted] = cache.try_emplace(address);
+    if (!inserted) {
+      results[i] = entry->second;
+      continue;
+    }
+    auto info = std::make_shared<SymbolInfo>();
+    entry->second = info;
+    results[i] = info;
+    fresh.emplace_back(addresses[i], info.get());
+    // Return addresses point behind the call, so look up the call itself.
+    auto lookup = address == 0 ? address : address - 1;
+    auto module = findModule(lookup);
+    if (!module) {
+      continue;
+    }
+    auto &batch = pending[module->path];
+    batch.offsets.push_back(lookup - module->bias);
+    batch.infos.push_back(info.get());
+  }
+
+  for (auto &[module, batch] : pending) {
+    if (auto *helper = helperFor(module)) {
+      helper->query(batch.offsets, batch.infos);
+    }
+  }
+  for (auto [address, info] : fresh) {
+    if (info->name.empty()) {
+      fallbackName(address, *info);
+    }
+  }
+  return results;
+}
+
+auto Symbolizer::resolve(const void *address)
+    -> std::shared_ptr<const SymbolInfo> {
+  auto addresses = std::array{address};
+  return resolve(addresses).front();
+}
+
+auto Symbolizer::resolveOffline(const std::string &module,
+                                std::span<const std::uintptr_t> offsets)
+    -> std::vector<SymbolInfo> {
+  auto lock = std::lock_guard(mutex);
+  auto results = std::vector<SymbolInfo>(offsets.size());
+  auto infos = std::vector<SymbolInfo *>();
+  for (auto &result : results) {
+    infos.push_back(&result);
+  }
+  if (auto *helper = helperFor(module)) {
+    helper->query(offsets, infos);
+  }
+  return results;
+}
+
+void Symbolizer::clearCache() {
+  auto lock = std::lock_guard(mutex);
+  cache.clear();
+}
+
+} // namespace errantibus::internal
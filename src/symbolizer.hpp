@@ -0,0 +1,86 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#ifndef ERRANTIBUS_SYMBOLIZER_HPP
+#define ERRANTIBUS_SYMBOLIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace errantibus::internal {
+
+/**
+ * @brief The resolved location of a single code address.
+ */
+struct SymbolInfo {
+  std::string name;
+  std::string file;
+  std::size_t line = 0;
+};
+
+/**
+ * @brief Resolves code addresses to function names and source locations.
+ *
+ * Instead of starting a fresh `addr2line` for every query, the symbolizer
+ * keeps one long-lived `addr2line` helper per loaded module and sends it
+ * all addresses of a trace at once. Results are cached by address, so
+ * repeated reports from the same call sites do not talk to the helpers again.
+ * A helper that does not answer in time is stopped, and its module is only
+ * resolved with `dladdr` from then on.
+ */
+class Symbolizer {
+public:
+  Symbolizer();
+  ~Symbolizer();
+  Symbolizer(const Symbolizer &) = delete;
+  Symbolizer(Symbolizer &&) = delete;
+  auto operator=(const Symbolizer &) -> Symbolizer & = delete;
+  auto operator=(Symbolizer &&) -> Symbolizer & = delete;
+
+  /**
+   * @brief The process wide instance. It is never destroyed, so it can
+   * still be used while the program is terminating.
+   */
+  static auto instance() -> Symbolizer &;
+
+  /**
+   * @brief Resolve all return addresses of a trace in one pass. The
+   * results stay valid while they are held, also if the cache drops them.
+   */
+  auto resolve(std::span<const void *const> addresses)
+      -> std::vector<std::shared_ptr<const SymbolInfo>>;
+
+  auto resolve(const void *address) -> std::shared_ptr<const SymbolInfo>;
+
+  /**
+   * @brief Resolve offsets into an object file that need not be loaded,
+   * e.g. from a crash record. These results are not cached.
+   */
+  auto resolveOffline(const std::string &module,
+                      std::span<const std::uintptr_t> offsets)
+      -> std::vector<SymbolInfo>;
+
+  void clearCache();
+
+private:
+  class Helper;
+
+  auto helperFor(const std::string &module) -> Helper *;
+
+  std::mutex mutex;
+  std::unordered_map<std::uintptr_t, std::shared_ptr<const SymbolInfo>> cache;
+  std::unordered_map<std::string, std::unique_ptr<Helper>> helpers;
+};
+
+} // namespace errantibus::internal
+
+#endif // !ERRANTIBUS_SYMBOLIZER_HPP
@@ -0,0 +1,57 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "errantibus/output.hpp"
+#include "report.hpp"
+
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+auto main(int argc, char **argv) -> int {
+  bool json = argc > 1 && std::string_view(argv[1]) == "--json";
+  auto arguments = std::span(argv, argc).subspan(json ? 2 : 1);
+  if (arguments.size() > 1) {
+    std::cerr << "usage: " << argv[0] << " [--json] [binary output]\n";
+    return 2;
+  }
+
+  auto data = std::string();
+  if (arguments.empty()) {
+    data.assign(std::istreambuf_iterator<char>(std::cin), {});
+  } else {
+    auto file = std::ifstream(arguments[0], std::ios::binary);
+    if (!file) {
+      std::cerr << arguments[0] << ": cannot be read\n";
+      return 1;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), {});
+  }
+
+  auto decoded = std::vector<errantibus::internal::DecodedEntry>();
+  bool complete = errantibus::internal::decodeBinary(data, decoded);
+  auto entries = std::vector<errantibus::Entry>();
+  for (const auto &entry : decoded) {
+    entries.push_back(entry.entry);
+  }
+  auto text = std::string();
+  if (json) {
+    errantibus::encodeJsonLines(text, entries, false);
+  } else {
+    errantibus::encodeText(text, entries, ::isatty(STDOUT_FILENO) == 1);
+  }
+  std::cout << text << std::flush;
+  if (!complete) {
+    std::cerr << "warning: the output ends in a malformed entry\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Errantibus, by Jakob Teuber
+ * See <https://github.com/jakobteuber/errantibus>
+ */
+
+#include "crashRecord.hpp"
+#include "report.hpp"
+#include "symbolizer.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using errantibus::internal::CrashModule;
+
+namespace {
+
+/**
+ * @brief The file to symbolize a module with. If the binary at the recorded
+ * path was rebuilt since the crash, its separate debug file is tried.
+ */
+auto objectFile(const CrashModule &module) -> std::string {
+  if (module.buildId.empty() ||
+      errantibus::internal::readBuildId(module.path) == module.buildId) {
+    return module.path;
+  }
+  auto hex = errantibus::internal::hexBuildId(module.buildId);
+  auto debugFile = std::filesystem::path("/usr/lib/debug/.build-id") /
+                   hex.substr(0, 2) / (hex.substr(2) + ".debug");
+  if (std::filesystem::exists(debugFile)) {
+    return debugFile;
+  }
+  std::cerr << "warning: " << module.path
+            << " does not match the crashed build (build-id " << hex
+            << ")\n";
+  return module.path;
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <crash record>\n";
+    return 2;
+  }
+  auto file = std::ifstream(argv[1], std::ios::binary);
+  auto data = std::string(std::istreambuf_iterator<char>(file), {});
+  auto record = errantibus::internal::decodeCrashRecord(data);
+  if (!file || !record) {
+    std::cerr << argv[1] << ": not a readable crash record\n";
+    return 1;
+  }
+
+  struct Batch {
+    std::vector<std::uintptr_t> offsets;
+    std::vector<std::size_t> frames;
+  };
+  auto batches = std::map<const CrashModule *, Batch>();
+  for (std::size_t i = 0; i < record->frames.size(); ++i) {
+    // Return addresses point behind the call, so look up the call itself.
+    auto address = record->frames[i];
+    auto lookup = address == 0 ? address : address - 1;
+    if (const auto *module =
+            errantibus::internal::findCrashModule(record->modules, lookup)) {
+      auto &batch = batches[module];
+      batch.offsets.push_back(lookup - module->bias);
+      batch.frames.push_back(i);
+    }
+  }
+
+  auto infos =
+      std::vector<errantibus::internal::SymbolInfo>(record->frames.size());
+  auto &symbolizer = errantibus::internal::Symbolizer::instance();
+  for (const auto &[module, batch] : batches) {
+    auto resolved = symbolizer.resolveOffline(objectFile(*module),
+                                              batch.offsets);
+    for (std::size_t i = 0; i < resolved.size(); ++i) {
+      infos[batch.frames[i]] = std::move(resolved[i]);
+    }
+  }
+
+  auto addresses = std::vector<const void *>();
+  auto symbols =
+      std::vector<std::shared_ptr<const errantibus::internal::SymbolInfo>>();
+  for (std::size_t i = 0; i < record->frames.size(); ++i) {
+    addresses.push_back(reinterpret_cast<const void *>(record->frames[i]));
+    symbols.push_back(std::make_shared<const errantibus::internal::SymbolInfo>(
+        std::move(infos[i])));
+  }
+  errantibus::internal::writeFrames(
+      std::cout, errantibus::internal::framesOf(addresses, symbols),
+      ::isatty(STDOUT_FILENO) == 1);
+  std::cout << record->report << std::flush;
+  return 0;
+}